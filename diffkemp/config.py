@@ -8,7 +8,12 @@ class ConfigException(Exception):
 
 class Config:
     def __init__(self, source_first, source_second, show_diff,
-                 control_flow_only, verbosity, semdiff_tool):
+                 control_flow_only, verbosity, semdiff_tool,
+                 use_simpll_server=False, use_simpll_batch=False,
+                 simpll_cache_dir=None, simpll_parallel=False,
+                 simpll_drop_unreachable=False,
+                 simpll_inlining_budget=None,
+                 simpll_drop_debug_info=False):
         """
         Store configuration of DiffKemp
         :param source_first: Sources for the first kernel (instance of
@@ -19,12 +24,37 @@ class Config:
         :param control_flow_only: Check only for control-flow differences.
         :param verbosity: Verbosity level (currently boolean).
         :param semdiff_tool: Tool to use for semantic diff
+        :param use_simpll_server: Use a persistent SimpLL server that keeps
+                                  parsed modules in memory.
+        :param use_simpll_batch: Compare functions sharing the same modules
+                                 in a single SimpLL run first.
+        :param simpll_cache_dir: Directory for the persistent cache of
+                                 function comparison results.
+        :param simpll_parallel: Preprocess the compared modules in parallel.
+        :param simpll_drop_unreachable: Delete bodies of functions that are
+                                        not reachable from the compared
+                                        functions before the comparison.
+        :param simpll_inlining_budget: Limits of inlining when comparing
+                                       a pair of functions in SimpLL (see
+                                       simplify_modules_diff), None for no
+                                       limits.
+        :param simpll_drop_debug_info: Drop debug metadata of functions that
+                                       are not reachable from the compared
+                                       functions once the debug info is
+                                       processed.
         """
         self.source_first = source_first
         self.source_second = source_second
         self.show_diff = show_diff
         self.control_flow_only = control_flow_only
         self.verbosity = verbosity
+        self.use_simpll_server = use_simpll_server
+        self.use_simpll_batch = use_simpll_batch
+        self.simpll_cache_dir = simpll_cache_dir
+        self.simpll_parallel = simpll_parallel
+        self.simpll_drop_unreachable = simpll_drop_unreachable
+        self.simpll_inlining_budget = simpll_inlining_budget
+        self.simpll_drop_debug_info = simpll_drop_debug_info
 
         # Semantic diff tool configuration
         self.semdiff_tool = semdiff_tool
@@ -6,6 +6,10 @@ from diffkemp.llvm_ir.kernel_source import KernelSource, \
     SourceNotFoundException
 from diffkemp.semdiff.function_diff import functions_diff
 from diffkemp.semdiff.result import Result
+from diffkemp.simpll.simpll import compare_function_list, enable_stats, \
+    generate_symbol_index, get_stats, SimpLLException
+from collections import OrderedDict
+from multiprocessing import Pool
 import os
 import re
 import shutil
@@ -65,6 +69,53 @@ def __make_argument_parser():
                             help="show functions that are either unknown or \
                             ended with an error in statistics",
                             action="store_true")
+    compare_ap.add_argument("--jobs", "-j",
+                            help="number of functions compared in parallel",
+                            type=int,
+                            default=1)
+    compare_ap.add_argument("--simpll-server",
+                            help="keep parsed LLVM modules in a persistent \
+                            SimpLL process",
+                            action="store_true")
+    compare_ap.add_argument("--simpll-cache-dir",
+                            help="directory to keep results of function \
+                            comparisons in across runs")
+    compare_ap.add_argument("--simpll-batch",
+                            help="compare functions sharing LLVM modules in \
+                            a single SimpLL run first",
+                            action="store_true")
+    compare_ap.add_argument("--simpll-parallel",
+                            help="preprocess the compared LLVM modules in \
+                            parallel in SimpLL",
+                            action="store_true")
+    compare_ap.add_argument("--simpll-drop-unreachable",
+                            help="delete bodies of functions unreachable \
+                            from the compared functions in SimpLL",
+                            action="store_true")
+    compare_ap.add_argument("--simpll-drop-debug-info",
+                            help="drop debug metadata of functions \
+                            unreachable from the compared functions in \
+                            SimpLL",
+                            action="store_true")
+    compare_ap.add_argument("--simpll-max-inlining-rounds",
+                            help="maximal number of inlining rounds when \
+                            comparing a pair of functions in SimpLL",
+                            type=int,
+                            default=0)
+    compare_ap.add_argument("--simpll-max-inlining-growth",
+                            help="maximal number of instructions that \
+                            inlining may add to a pair of compared functions",
+                            type=int,
+                            default=0)
+    compare_ap.add_argument("--simpll-max-inlined-size",
+                            help="maximal size of a function that may be \
+                            inlined during comparison",
+                            type=int,
+                            default=0)
+    compare_ap.add_argument("--simpll-stats",
+                            help="report times of phases and counters of \
+                            work done by SimpLL",
+                            action="store_true")
     compare_ap.set_defaults(func=compare)
     return ap
 
@@ -110,6 +161,15 @@ def generate(args):
 
     # Copy LLVM files to the snapshot
     source.copy_source_files(fun_list.modules(), args.output_dir)
+    # Store the modules also as bitcode (it is faster to load)
+    for mod in fun_list.modules():
+        mod.generate_bitcode()
+    # Create index of symbols defined by the modules
+    try:
+        generate_symbol_index([mod.llvm for mod in fun_list.modules()],
+                              os.path.join(args.output_dir, "symbols.yaml"))
+    except SimpLLException as e:
+        print(e)
     source.copy_cscope_files(args.output_dir)
 
     # Create YAML with functions list
@@ -138,52 +198,193 @@ def compare(args):
 
     config = Config(old_source, new_source, args.show_diff,
                     args.control_flow_only, args.verbose,
-                    args.semdiff_tool)
+                    args.semdiff_tool, args.simpll_server,
+                    args.simpll_batch,
+                    os.path.abspath(args.simpll_cache_dir)
+                    if args.simpll_cache_dir else None,
+                    args.simpll_parallel, args.simpll_drop_unreachable,
+                    (args.simpll_max_inlining_rounds,
+                     args.simpll_max_inlining_growth,
+                     args.simpll_max_inlined_size),
+                    args.simpll_drop_debug_info)
     result = Result(Result.Kind.NONE, args.snapshot_dir_old,
                     args.snapshot_dir_old)
 
-    for fun, old_mod in sorted(old_functions.functions.items()):
-        new_mod = new_functions.get_by_name(fun)
-        if not (old_mod.has_function(fun) and new_mod.has_function(fun)):
-            continue
-
-        fun_result = functions_diff(
-            mod_first=old_mod, mod_second=new_mod,
-            fun_first=fun, fun_second=fun,
-            glob_var=None, config=config)
-
-        if fun_result is not None:
-            if args.regex_filter is not None:
-                # Filter results by regex
-                pattern = re.compile(args.regex_filter)
-                for called_res in fun_result.inner.values():
-                    if pattern.search(called_res.diff):
-                        break
-                else:
-                    fun_result.kind = Result.Kind.EQUAL_SYNTAX
-
-            result.add_inner(fun_result)
-            if fun_result.kind in [Result.Kind.ERROR, Result.Kind.UNKNOWN]:
-                print("{}: {}".format(fun, str(fun_result.kind)))
-            elif fun_result.kind == Result.Kind.NOT_EQUAL:
-                print_syntax_diff(args.snapshot_dir_old,
-                                  args.snapshot_dir_new,
-                                  fun, fun_result, False,
-                                  args.show_diff)
-
-        # Clean LLVM modules (allow GC to collect the occupied memory)
-        old_mod.clean_module()
-        new_mod.clean_module()
-        LlvmKernelModule.clean_all()
+    if args.simpll_stats:
+        enable_stats()
+
+    functions = [(fun, old_mod, new_functions.get_by_name(fun))
+                 for fun, old_mod in sorted(old_functions.functions.items())]
+    if args.jobs > 1:
+        # Compare groups of functions in parallel and process the results
+        # in the same order as the sequential comparison does.
+        fun_results = dict()
+        with Pool(args.jobs, initializer=_init_worker,
+                  initargs=(config, args.simpll_stats)) as pool:
+            for group_results, group_stats in pool.imap_unordered(
+                    _compare_group, _group_by_modules(functions)):
+                fun_results.update(group_results)
+                if group_stats is not None:
+                    get_stats().merge(group_stats)
+        for fun, _, _ in functions:
+            if fun in fun_results:
+                _process_fun_result(args, result, fun, fun_results[fun])
+    else:
+        equal_funs = _batch_equal_functions(functions, config)
+        for fun, old_mod, new_mod in functions:
+            if fun in equal_funs:
+                fun_result = Result(Result.Kind.EQUAL_SYNTAX, fun, fun)
+            elif not (old_mod.has_function(fun) and
+                      new_mod.has_function(fun)):
+                continue
+            else:
+                fun_result = _compare_function(fun, old_mod, new_mod, config)
+            _process_fun_result(args, result, fun, fun_result)
 
     if args.report_stat:
         print("")
         print("Statistics")
         print("----------")
         result.report_stat(args.show_errors)
+    if args.simpll_stats:
+        print("")
+        print("SimpLL statistics")
+        print("-----------------")
+        get_stats().report()
     return 0
 
 
+def _compare_function(fun, old_mod, new_mod, config):
+    """Compare a single function and clean the used LLVM modules."""
+    fun_result = functions_diff(
+        mod_first=old_mod, mod_second=new_mod,
+        fun_first=fun, fun_second=fun,
+        glob_var=None, config=config)
+
+    # Clean LLVM modules (allow GC to collect the occupied memory)
+    old_mod.clean_module()
+    new_mod.clean_module()
+    LlvmKernelModule.clean_all()
+    return fun_result
+
+
+def _batch_equal_functions(functions, config):
+    """
+    Find syntactically equal functions by comparing all functions that share
+    the same pair of modules in a single SimpLL run. Functions that are not
+    found equal this way must be compared separately.
+    :param functions: List of triples (function, old module, new module).
+    :param config: Configuration.
+    :return: Set of syntactically equal functions.
+    """
+    equal = set()
+    if not config.use_simpll_batch:
+        return equal
+
+    by_modules = OrderedDict()
+    for fun, old_mod, new_mod in functions:
+        by_modules.setdefault((old_mod.llvm, new_mod.llvm), []).append(fun)
+    for (old_llvm, new_llvm), funs in by_modules.items():
+        if len(funs) < 2:
+            continue
+        try:
+            equal.update(compare_function_list(old_llvm, new_llvm, funs,
+                                               config.control_flow_only,
+                                               config.verbosity,
+                                               config.simpll_cache_dir,
+                                               config.simpll_parallel,
+                                               config.simpll_drop_unreachable,
+                                               config.simpll_inlining_budget,
+                                               config.simpll_drop_debug_info))
+        except SimpLLException:
+            pass
+    return equal
+
+
+def _process_fun_result(args, result, fun, fun_result):
+    """Add the result of a function comparison to the overall result."""
+    if fun_result is None:
+        return
+    if args.regex_filter is not None:
+        # Filter results by regex
+        pattern = re.compile(args.regex_filter)
+        for called_res in fun_result.inner.values():
+            if pattern.search(called_res.diff):
+                break
+        else:
+            fun_result.kind = Result.Kind.EQUAL_SYNTAX
+
+    result.add_inner(fun_result)
+    if fun_result.kind in [Result.Kind.ERROR, Result.Kind.UNKNOWN]:
+        print("{}: {}".format(fun, str(fun_result.kind)))
+    elif fun_result.kind == Result.Kind.NOT_EQUAL:
+        print_syntax_diff(args.snapshot_dir_old,
+                          args.snapshot_dir_new,
+                          fun, fun_result, False,
+                          args.show_diff)
+
+
+def _group_by_modules(functions):
+    """
+    Split compared functions into groups so that functions sharing an LLVM
+    module (in either of the snapshots) belong to the same group. Groups can
+    be then compared independently of each other since they never work with
+    the same files.
+    :param functions: List of triples (function, old module, new module).
+    :return: List of groups, the largest groups first.
+    """
+    parent = dict()
+
+    def find(mod):
+        while parent.setdefault(mod, mod) != mod:
+            parent[mod] = parent[parent[mod]]
+            mod = parent[mod]
+        return mod
+
+    for _, old_mod, new_mod in functions:
+        parent[find(old_mod.llvm)] = find(new_mod.llvm)
+
+    groups = OrderedDict()
+    for fun in functions:
+        groups.setdefault(find(fun[1].llvm), []).append(fun)
+    return sorted(groups.values(), key=len, reverse=True)
+
+
+# Configuration of the worker process for parallel comparison
+_worker_config = None
+_worker_stats = False
+
+
+def _init_worker(config, stats):
+    """Initialize a worker process for parallel comparison."""
+    global _worker_config, _worker_stats
+    _worker_config = config
+    _worker_stats = stats
+
+
+def _compare_group(group):
+    """
+    Compare a group of functions (run in a worker process).
+    :param group: List of triples (function, old module, new module).
+    :return: List of pairs (function, result of its comparison) and
+             statistics of SimpLL runs done for the group (None if they are
+             not collected).
+    """
+    if _worker_stats:
+        enable_stats()
+    results = []
+    equal_funs = _batch_equal_functions(group, _worker_config)
+    for fun, old_mod, new_mod in group:
+        if fun in equal_funs:
+            results.append((fun, Result(Result.Kind.EQUAL_SYNTAX, fun, fun)))
+            continue
+        if not (old_mod.has_function(fun) and new_mod.has_function(fun)):
+            continue
+        results.append(
+            (fun, _compare_function(fun, old_mod, new_mod, _worker_config)))
+    return results, get_stats()
+
+
 def logs_dirname(src_version, dest_version):
     """Name of the directory to put log files into."""
     return "kabi-diff-{}_{}".format(src_version, dest_version)
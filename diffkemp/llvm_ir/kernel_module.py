@@ -23,6 +23,19 @@ def supported_kernel_fun(llvm_fun):
                 any([name.startswith(p) for p in supported_prefixes]))
 
 
+def get_ir_input_file(llvm_file):
+    """
+    Get the file that the LLVM module should be loaded from. If there is
+    a bitcode version of the module (a .bc file next to the .ll file) that is
+    up to date, it is preferred since it is faster to load.
+    """
+    bitcode = os.path.splitext(llvm_file)[0] + ".bc"
+    if (os.path.isfile(bitcode) and os.path.isfile(llvm_file) and
+            os.path.getmtime(bitcode) >= os.path.getmtime(llvm_file)):
+        return bitcode
+    return llvm_file
+
+
 class KernelModuleException(Exception):
     pass
 
@@ -55,7 +68,8 @@ class LlvmKernelModule:
     def parse_module(self, force=False):
         """Parse module file into LLVM module using llvmcpy library"""
         if force or self.llvm_module is None:
-            buffer = create_memory_buffer_with_contents_of_file(self.llvm)
+            buffer = create_memory_buffer_with_contents_of_file(
+                get_ir_input_file(self.llvm))
             context = get_global_context()
             self.llvm_module = context.parse_ir(buffer)
 
@@ -65,6 +79,20 @@ class LlvmKernelModule:
             self.llvm_module.dispose()
             self.llvm_module = None
 
+    def generate_bitcode(self):
+        """
+        Store the module also in the bitcode format (next to the .ll file).
+        Bitcode is parsed faster than the textual IR and it allows SimpLL to
+        load only the functions that it needs.
+        """
+        bitcode = os.path.splitext(self.llvm)[0] + ".bc"
+        with open(os.devnull, "w") as devnull:
+            try:
+                check_call(["llvm-as", self.llvm, "-o", bitcode],
+                           stdout=devnull, stderr=devnull)
+            except CalledProcessError:
+                pass
+
     @staticmethod
     def clean_all():
         """Clean all statically managed LLVM memory."""
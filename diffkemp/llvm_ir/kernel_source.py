@@ -9,6 +9,7 @@ import errno
 import os
 import shutil
 from subprocess import CalledProcessError, check_call, check_output
+import yaml
 
 
 class SourceNotFoundException(Exception):
@@ -30,6 +31,7 @@ class KernelSource:
         self.kernel_dir = os.path.abspath(kernel_dir)
         self.builder = LlvmKernelBuilder(kernel_dir) if with_builder else None
         self.modules = dict()
+        self.symbol_index = None
 
     def initialize(self):
         """
@@ -45,6 +47,15 @@ class KernelSource:
         if self.builder:
             self.builder.finalize()
 
+    def get_symbol_index(self):
+        """
+        Get the index of LLVM modules defining symbols of the kernel. The index
+        is stored in the symbols.yaml file in the kernel directory.
+        :return: Path to the index or None if the index does not exist.
+        """
+        index = os.path.join(self.kernel_dir, "symbols.yaml")
+        return index if os.path.isfile(index) else None
+
     def get_sources_with_params(self, directory):
         """
         Get list of .c files in the given directory and all its subdirectories
@@ -265,6 +276,23 @@ class KernelSource:
         self.modules[name] = mod
         return mod
 
+    def _load_symbol_index(self):
+        """
+        Load the index of modules defining symbols (if it exists). The index
+        maps each symbol to the name of the module relative to the kernel
+        directory.
+        """
+        if self.symbol_index is not None:
+            return
+        self.symbol_index = dict()
+        index = self.get_symbol_index()
+        if index:
+            with open(index, "r") as index_file:
+                entries = yaml.safe_load(index_file)
+            for entry in entries or []:
+                self.symbol_index.setdefault(entry["symbol"],
+                                             entry["module"])
+
     def get_module_for_symbol(self, symbol):
         """
         Looks up files containing definition of a symbol using CScope, then
@@ -272,9 +300,20 @@ class KernelSource:
         actually defined in the created module.
         In case there are multiple files containing the definition, the first
         module containing the function definition is returned.
+        If the kernel directory contains an index of modules defining symbols
+        (created when generating snapshots), the index is used first. Symbols
+        that are not in the index are looked up using CScope.
         :param symbol: Name of the function to look up.
         :returns LLVM module containing the specified function.
         """
+        self._load_symbol_index()
+        if symbol in self.symbol_index:
+            llvm_file = self.symbol_index[symbol]
+            mod = self.get_module_from_source(
+                "{}.c".format(os.path.splitext(llvm_file)[0]))
+            if mod:
+                return mod
+
         mod = None
 
         srcs = self.find_srcs_with_symbol_def(symbol)
@@ -151,24 +151,38 @@ def functions_diff(mod_first, mod_second,
             print("Syntactic diff of {} (in {})".format(fun_str,
                                                         mod_first.llvm))
 
+        # If there are indices of modules defining symbols, SimpLL links
+        # missing definitions itself. Definitions that SimpLL could not link
+        # are reported as missing and they are searched for below.
+        link_indices = (config.source_first.get_symbol_index(),
+                        config.source_second.get_symbol_index())
         simplify = True
         while simplify:
             simplify = False
             # Simplify modules
             first_simpl, second_simpl, objects_to_compare, missing_defs, \
-                syndiff_bodies = \
+                syndiff_bodies, unknown_funs = \
                 simplify_modules_diff(mod_first.llvm, mod_second.llvm,
                                       fun_first, fun_second,
                                       glob_var.name if glob_var else None,
                                       glob_var.name if glob_var else "simpl",
                                       config.control_flow_only,
-                                      config.verbosity)
+                                      config.verbosity,
+                                      config.use_simpll_server,
+                                      config.simpll_cache_dir,
+                                      link_indices,
+                                      config.simpll_parallel,
+                                      config.simpll_drop_unreachable,
+                                      config.simpll_inlining_budget,
+                                      config.simpll_drop_debug_info)
             funs_to_compare = list([o for o in objects_to_compare
                                     if not o[0].is_syn_diff])
             if funs_to_compare and missing_defs:
                 # If there are missing function definitions, try to find
                 # implementing them, link those to the current modules, and
-                # rerun the simplification.
+                # rerun the simplification. The simplification is rerun only
+                # if some definition was linked, hence definitions that cannot
+                # be found do not cause an infinite loop.
                 for fun_pair in missing_defs:
                     if "first" in fun_pair:
                         try:
@@ -191,7 +205,15 @@ def functions_diff(mod_first, mod_second,
         mod_first.restore_unlinked_llvm()
         mod_second.restore_unlinked_llvm()
 
-        if not objects_to_compare:
+        # Comparison of some functions did not finish in SimpLL
+        for unknown in unknown_funs:
+            fun_result = Result(Result.Kind.UNKNOWN, unknown["first"],
+                                unknown["second"])
+            if config.verbosity:
+                print("  {}: {}".format(unknown["first"], unknown["reason"]))
+            result.add_inner(fun_result)
+
+        if not objects_to_compare and not unknown_funs:
             result.kind = Result.Kind.EQUAL_SYNTAX
         else:
             # If the functions are not syntactically equal, objects_to_compare
@@ -7,6 +7,8 @@ using the given parameter is compared individually.
 from diffkemp.llvm_ir.build_llvm import BuildException
 from diffkemp.semdiff.function_diff import functions_diff
 from diffkemp.semdiff.result import Result
+from diffkemp.simpll.simpll import compare_variable_list, SimpLLException
+from collections import OrderedDict
 
 
 def diff_all_modules_using_global(glob_first, glob_second, config):
@@ -17,40 +19,117 @@ def diff_all_modules_using_global(glob_first, glob_second, config):
     :param glob_second: Second global to compare
     :param config: Configuration
     """
-    result = Result(Result.Kind.NONE, glob_first.name, glob_second.name)
-    if glob_first.name != glob_second.name:
-        # Variables with different names are treated as unequal
-        result.kind = Result.Kind.NOT_EQUAL
-        return result
-
-    srcs_first = config.source_first.find_srcs_using_symbol(glob_first.name)
-    srcs_second = config.source_second.find_srcs_using_symbol(glob_second.name)
-    # Compare all sources containing functions using the variable
-    for src in srcs_first:
-        if src not in srcs_second:
-            result.add_inner(Result(Result.Kind.NOT_EQUAL, src, src))
-        else:
-            try:
-                mod_first = config.source_first.get_module_from_source(src)
-                mod_second = config.source_second.get_module_from_source(src)
-                mod_first.parse_module()
-                mod_second.parse_module()
-                if (mod_first.has_global(glob_first.name) and
-                        mod_second.has_global(glob_second.name)):
-                    src_result = modules_diff(
-                        mod_first=mod_first, mod_second=mod_second,
-                        glob_var=glob_first, fun=None,
-                        config=config)
-                    for res in src_result.inner.values():
-                        result.add_inner(res)
-            except BuildException as e:
-                if config.verbosity:
-                    print(e)
-                result.add_inner(Result(Result.Kind.ERROR, src, src))
-    return result
+    return diff_all_modules_using_globals([glob_first], [glob_second],
+                                          config)[glob_first.name]
+
+
+def diff_all_modules_using_globals(globs_first, globs_second, config):
+    """
+    Compare semantics of all modules using any of the given global variables
+    (e.g. data variables of multiple sysctl options). The result w.r.t. each
+    pair of globals is the same as diff_all_modules_using_global gives, but
+    each module is built and compared w.r.t. all globals that it uses at once
+    (see modules_diff_globals).
+    :param globs_first: List of first globals to compare
+    :param globs_second: List of second globals to compare (corresponding to
+                         the first globals)
+    :param config: Configuration
+    :return: Dictionary mapping names of the first globals to the results.
+    """
+    results = OrderedDict()
+    # Sources using each of the globals (in both kernels)
+    srcs_globals = OrderedDict()
+    for glob_first, glob_second in zip(globs_first, globs_second):
+        result = Result(Result.Kind.NONE, glob_first.name, glob_second.name)
+        results[glob_first.name] = result
+        if glob_first.name != glob_second.name:
+            # Variables with different names are treated as unequal
+            result.kind = Result.Kind.NOT_EQUAL
+            continue
+
+        srcs_first = config.source_first.find_srcs_using_symbol(
+            glob_first.name)
+        srcs_second = config.source_second.find_srcs_using_symbol(
+            glob_second.name)
+        for src in srcs_first:
+            if src not in srcs_second:
+                result.add_inner(Result(Result.Kind.NOT_EQUAL, src, src))
+            else:
+                srcs_globals.setdefault(src, []).append(glob_first)
+
+    # Compare all sources containing functions using the variables
+    for src, globs in srcs_globals.items():
+        try:
+            mod_first = config.source_first.get_module_from_source(src)
+            mod_second = config.source_second.get_module_from_source(src)
+            mod_first.parse_module()
+            mod_second.parse_module()
+            globs = [glob for glob in globs
+                     if (mod_first.has_global(glob.name) and
+                         mod_second.has_global(glob.name))]
+            src_results = modules_diff_globals(
+                mod_first=mod_first, mod_second=mod_second,
+                glob_vars=globs, config=config)
+            for glob in globs:
+                for res in src_results[glob.name].inner.values():
+                    results[glob.name].add_inner(res)
+        except BuildException as e:
+            if config.verbosity:
+                print(e)
+            for glob in globs:
+                results[glob.name].add_inner(
+                    Result(Result.Kind.ERROR, src, src))
+    return results
+
+
+def modules_diff_globals(mod_first, mod_second, glob_vars, config):
+    """
+    Analyse semantic difference of two LLVM IR modules w.r.t. each of
+    the given parameters. The results are the same as if modules_diff was
+    called for each parameter, but functions using multiple parameters are
+    first compared w.r.t. all of them in a single SimpLL run. Only
+    the parameters w.r.t. which such a function is not syntactically equal
+    are then compared separately.
+    :param mod_first: First LLVM module
+    :param mod_second: Second LLVM module
+    :param glob_vars: List of parameters (global variables) to compare.
+    :param config: Configuration.
+    :return: Dictionary mapping names of parameters to the results.
+    """
+    # Parameters used by each function (in both modules)
+    fun_params = OrderedDict()
+    for glob_var in glob_vars:
+        funs_second = mod_second.get_functions_using_param(glob_var)
+        for fun in mod_first.get_functions_using_param(glob_var):
+            if fun in funs_second:
+                fun_params.setdefault(fun, []).append(glob_var.name)
+
+    equal_syntax = dict()
+    for fun, params in fun_params.items():
+        if (len(params) < 2 or not mod_first.has_function(fun) or
+                not mod_second.has_function(fun)):
+            continue
+        try:
+            equal_syntax[fun] = compare_variable_list(
+                mod_first.llvm, mod_second.llvm, fun, params,
+                config.control_flow_only, config.verbosity,
+                config.simpll_cache_dir, config.simpll_parallel,
+                config.simpll_drop_unreachable, config.simpll_inlining_budget,
+                config.simpll_drop_debug_info)
+        except SimpLLException:
+            pass
+
+    results = OrderedDict()
+    for glob_var in glob_vars:
+        results[glob_var.name] = modules_diff(
+            mod_first=mod_first, mod_second=mod_second,
+            glob_var=glob_var, fun=None, config=config,
+            equal_syntax=equal_syntax)
+    return results
 
 
-def modules_diff(mod_first, mod_second, glob_var, fun, config):
+def modules_diff(mod_first, mod_second, glob_var, fun, config,
+                 equal_syntax=None):
     """
     Analyse semantic difference of two LLVM IR modules w.r.t. some parameter
     :param mod_first: First LLVM module
@@ -59,6 +138,9 @@ def modules_diff(mod_first, mod_second, glob_var, fun, config):
                   functions using this variable are compared).
     :param fun: Function to be compared.
     :param config: Configuration.
+    :param equal_syntax: Dictionary mapping functions to sets of parameters
+                         w.r.t. which they are already known to be
+                         syntactically equal. These are not compared again.
     """
     result = Result(Result.Kind.NONE, mod_first, mod_second)
 
@@ -81,6 +163,11 @@ def modules_diff(mod_first, mod_second, glob_var, fun, config):
             result.kind = Result.Kind.ERROR
             return result
 
+        if (equal_syntax and glob_var and
+                glob_var.name in equal_syntax.get(fun, set())):
+            result.add_inner(Result(Result.Kind.EQUAL_SYNTAX, fun, fun))
+            continue
+
         fun_result = functions_diff(mod_first=mod_first, mod_second=mod_second,
                                     fun_first=fun, fun_second=fun,
                                     glob_var=glob_var, config=config)
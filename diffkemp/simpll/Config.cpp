@@ -13,18 +13,27 @@
 //===----------------------------------------------------------------------===//
 
 #include "Config.h"
-#include <llvm/Support/raw_ostream.h>
+#include "Utils.h"
 #include <llvm/Support/Debug.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/LineIterator.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <set>
 
 // Command line options
-cl::opt<std::string> FirstFileOpt(cl::Positional, cl::Required,
-                                  cl::desc("<first file>"));
-cl::opt<std::string> SecondFileOpt(cl::Positional, cl::Required,
-                                   cl::desc("<second file>"));
+cl::opt<std::string> FirstFileOpt(cl::Positional, cl::desc("<first file>"));
+cl::opt<std::string> SecondFileOpt(cl::Positional, cl::desc("<second file>"));
 cl::opt<std::string> FunctionOpt("fun", cl::value_desc("function"),
                                  cl::desc("Specify function to be analysed"));
+cl::opt<std::string> FunctionListOpt("fun-list", cl::value_desc("file"),
+        cl::desc("Analyse all functions listed in the file (one function or "
+                 "a comma-separated pair of functions per line)"));
 cl::opt<std::string> VariableOpt("var", cl::value_desc("variable"), cl::desc(
         "Do analysis w.r.t. the value of the given variable"));
+cl::opt<std::string> VariableListOpt("var-list", cl::value_desc("file"),
+        cl::desc("Do analysis w.r.t. the value of each variable listed in "
+                 "the file (one variable per line) separately"));
 cl::opt<std::string> SuffixOpt("suffix", cl::value_desc("suffix"), cl::desc(
         "Add suffix to names of simplified files."));
 cl::opt<bool> ControlFlowOpt("control-flow", cl::desc(
@@ -33,6 +42,63 @@ cl::opt<bool> PrintCallstacksOpt("print-callstacks", cl::desc(
         "Print call stacks for non-equal functions."));
 cl::opt<bool> VerboseOpt("verbose", cl::desc(
         "Show verbose output (debugging information)."));
+cl::opt<std::string> CacheDirOpt("cache-dir", cl::value_desc("directory"),
+        cl::desc("Directory to store results of function comparison in so "
+                 "that they can be reused by subsequent runs."));
+cl::opt<bool> ParallelOpt("parallel", cl::desc(
+        "Preprocess the compared modules in parallel."));
+cl::opt<bool> DropUnreachableOpt("drop-unreachable", cl::desc(
+        "Delete bodies of functions that are not reachable from the compared "
+        "function before the comparison."));
+cl::opt<bool> DropDebugInfoOpt("drop-unreachable-debug-info", cl::desc(
+        "Drop debug metadata of functions that are not reachable from the "
+        "compared functions once the debug info is processed."));
+cl::opt<bool> VerdictOnlyOpt("verdict-only", cl::desc(
+        "Do not write the simplified modules if all functions are equal."));
+cl::opt<bool> ReportOnlyOpt("report-only", cl::desc(
+        "Only report the results, do not write the simplified modules."));
+cl::opt<unsigned> MaxInliningRoundsOpt("max-inlining-rounds", cl::init(0),
+        cl::value_desc("rounds"), cl::desc(
+        "Maximal number of inlining rounds when comparing a pair of functions "
+        "(0 for no limit)."));
+cl::opt<unsigned> MaxInliningGrowthOpt("max-inlining-growth",
+        cl::init(0), cl::value_desc("instructions"), cl::desc(
+        "Maximal number of instructions that inlining may add to a pair of "
+        "compared functions (0 for no limit)."));
+cl::opt<unsigned> MaxInlinedSizeOpt("max-inlined-size", cl::init(0),
+        cl::value_desc("instructions"), cl::desc(
+        "Maximal size of a function that may be inlined during comparison "
+        "(0 for no limit)."));
+cl::opt<bool> NoResumeOpt("no-resume", cl::Hidden, cl::desc(
+        "Compare functions from the start after each inlining round instead "
+        "of resuming the comparison (for testing)."));
+cl::opt<std::string> FirstLinkIndexOpt("first-link-index",
+        cl::value_desc("file|directory"), cl::desc(
+        "Index of modules defining functions of the first program (or "
+        "a directory with the modules). Used to link missing definitions."));
+cl::opt<std::string> SecondLinkIndexOpt("second-link-index",
+        cl::value_desc("file|directory"), cl::desc(
+        "Index of modules defining functions of the second program (or "
+        "a directory with the modules). Used to link missing definitions."));
+cl::opt<std::string> SymbolIndexOpt("symbol-index", cl::value_desc("file"),
+        cl::desc("Print an index of symbols defined by the modules listed in "
+                 "the file (one module per line)."));
+cl::opt<bool> ServerOpt("server", cl::desc(
+        "Run as a server reading comparison requests from stdin."));
+cl::opt<unsigned> ServerCacheSizeOpt("server-cache-size", cl::init(32),
+        cl::value_desc("modules"), cl::desc(
+        "Maximal number of parsed modules kept by the server."));
+cl::opt<bool> StatsOpt("stats", cl::desc(
+        "Report times of individual phases and counters of the done work."));
+
+/// Get the inlining budget from the command line options.
+static InliningBudget getInliningBudget() {
+    InliningBudget Budget;
+    Budget.MaxRounds = MaxInliningRoundsOpt;
+    Budget.MaxGrowth = MaxInliningGrowthOpt;
+    Budget.MaxCalleeSize = MaxInlinedSizeOpt;
+    return Budget;
+}
 
 /// Add suffix to the file name.
 /// \param File Original file name.
@@ -43,47 +109,216 @@ std::string addSuffix(std::string File, std::string Suffix) {
     return File.substr(0, dotPos) + "-" + Suffix + File.substr(dotPos);
 }
 
+/// Get name of the output file for the given input file. Simplified modules
+/// are always written as textual LLVM IR, hence the output of a bitcode
+/// module goes to the corresponding .ll file.
+static std::string getOutFile(StringRef File) {
+    if (File.endswith(".bc"))
+        return (File.drop_back(3) + ".ll").str();
+    return File;
+}
+
 /// Parsing command line options.
-Config::Config() : First(parseIRFile(FirstFileOpt, err, context_first)),
-                   Second(parseIRFile(SecondFileOpt, err, context_second)),
-                   FirstOutFile(FirstFileOpt), SecondOutFile(SecondFileOpt),
+/// Modules are loaded lazily: for bitcode files, only bodies of functions that
+/// may be needed for the comparison are materialized.
+Config::Config() : First(getLazyIRFileModule(FirstFileOpt, err,
+                                             context_first)),
+                   Second(getLazyIRFileModule(SecondFileOpt, err,
+                                              context_second)),
+                   FirstOutFile(getOutFile(FirstFileOpt)),
+                   SecondOutFile(getOutFile(SecondFileOpt)),
                    ControlFlowOnly(ControlFlowOpt),
-                   PrintCallStacks(PrintCallstacksOpt) {
-    if (!FunctionOpt.empty()) {
-        // Parse --fun option - find functions with given names.
-        // The option can be either single function name (same for both modules)
-        // or two function names separated by a comma.
-        auto commaPos = FunctionOpt.find(',');
-        std::string first_name;
-        std::string second_name;
-        if (commaPos == std::string::npos) {
-            first_name = FunctionOpt;
-            second_name = FunctionOpt;
-        } else {
-            first_name = FunctionOpt.substr(0, commaPos);
-            second_name = FunctionOpt.substr(commaPos + 1);
+                   PrintCallStacks(PrintCallstacksOpt), CacheDir(CacheDirOpt),
+                   Parallel(ParallelOpt), DropUnreachable(DropUnreachableOpt),
+                   DropDebugInfo(DropDebugInfoOpt),
+                   VerdictOnly(VerdictOnlyOpt), ReportOnly(ReportOnlyOpt),
+                   Inlining(getInliningBudget()),
+                   ResumeAfterInlining(!NoResumeOpt),
+                   FirstLinkIndex(FirstLinkIndexOpt),
+                   SecondLinkIndex(SecondLinkIndexOpt) {
+    if (!FunctionOpt.empty())
+        setFunctionNames(FunctionOpt);
+    if (!FunctionListOpt.empty())
+        setFunctionList(FunctionListOpt);
+    if (First && Second)
+        materializeFunctions();
+    if (!VariableOpt.empty())
+        setVariables(VariableOpt);
+    if (!VariableListOpt.empty())
+        setVariableList(VariableListOpt);
+    if (!SuffixOpt.empty())
+        setOutFileSuffix(SuffixOpt);
+}
+
+/// Configuration for already parsed modules.
+Config::Config(std::unique_ptr<Module> FirstMod,
+               std::unique_ptr<Module> SecondMod,
+               const std::string &FirstFile,
+               const std::string &SecondFile,
+               const std::string &Fun,
+               const std::string &Var,
+               const std::string &Suffix,
+               bool ControlFlowOnly,
+               bool PrintCallStacks)
+        : First(std::move(FirstMod)), Second(std::move(SecondMod)),
+          FirstOutFile(getOutFile(FirstFile)),
+          SecondOutFile(getOutFile(SecondFile)),
+          ControlFlowOnly(ControlFlowOnly), PrintCallStacks(PrintCallStacks),
+          CacheDir(CacheDirOpt), Parallel(ParallelOpt),
+          DropUnreachable(DropUnreachableOpt),
+          DropDebugInfo(DropDebugInfoOpt), VerdictOnly(VerdictOnlyOpt),
+          ReportOnly(ReportOnlyOpt), Inlining(getInliningBudget()),
+          ResumeAfterInlining(!NoResumeOpt), FirstLinkIndex(FirstLinkIndexOpt),
+          SecondLinkIndex(SecondLinkIndexOpt) {
+    if (!Fun.empty())
+        setFunctionNames(Fun);
+    if (!Var.empty())
+        setVariables(Var);
+    if (!Suffix.empty())
+        setOutFileSuffix(Suffix);
+}
+
+/// Parse --fun option - find functions with given names.
+/// The option can be either single function name (same for both modules)
+/// or two function names separated by a comma.
+void Config::setFunctionNames(const std::string &Fun) {
+    auto commaPos = Fun.find(',');
+    if (commaPos == std::string::npos) {
+        FirstFunName = Fun;
+        SecondFunName = Fun;
+    } else {
+        FirstFunName = Fun.substr(0, commaPos);
+        SecondFunName = Fun.substr(commaPos + 1);
+    }
+    refreshFunctions();
+}
+
+/// Parse --fun-list option - read the list of compared functions.
+/// Each non-empty line of the file has the same format as the --fun option.
+void Config::setFunctionList(const std::string &File) {
+    auto Buffer = MemoryBuffer::getFile(File);
+    if (!Buffer) {
+        errs() << "Cannot read function list " << File << "\n";
+        return;
+    }
+    for (line_iterator Line(**Buffer); !Line.is_at_end(); ++Line) {
+        StringRef Fun = Line->trim();
+        if (!Fun.empty())
+            FunctionList.push_back(Fun);
+    }
+}
+
+/// Materialize bodies of functions of lazily loaded modules.
+/// If the compared functions are known, only functions that are transitively
+/// referenced from them in any of the modules are materialized (functions
+/// having the same name are compared with each other, hence a function needed
+/// in one of the modules must be materialized in both of them). Bodies of the
+/// remaining functions are never loaded, these functions become declarations.
+void Config::materializeFunctions() {
+    std::vector<std::string> Worklist;
+    if (!FirstFunName.empty()) {
+        Worklist.push_back(FirstFunName);
+        Worklist.push_back(SecondFunName);
+    }
+    for (auto &Fun : FunctionList) {
+        auto FunNames = StringRef(Fun).split(',');
+        Worklist.push_back(FunNames.first);
+        if (!FunNames.second.empty())
+            Worklist.push_back(FunNames.second);
+    }
+
+    if (!Worklist.empty()) {
+        std::set<std::string> Needed;
+        std::set<const Constant *> Visited;
+        while (!Worklist.empty()) {
+            std::string Name = Worklist.back();
+            Worklist.pop_back();
+            if (!Needed.insert(Name).second)
+                continue;
+
+            for (Module *Mod : {First.get(), Second.get()}) {
+                Function *Fun = Mod->getFunction(Name);
+                if (!Fun)
+                    continue;
+                if (Error E = Fun->materialize()) {
+                    logAllUnhandledErrors(std::move(E), errs(),
+                                          "Cannot load " + Name + ": ");
+                    continue;
+                }
+                std::vector<const Function *> Referenced;
+                for (auto &BB : *Fun)
+                    for (auto &Inst : BB)
+                        for (auto &Op : Inst.operands())
+                            collectReferencedFunctions(Op.get(), Visited,
+                                                       Referenced);
+                for (auto *RefFun : Referenced)
+                    Worklist.push_back(RefFun->getName());
+            }
+        }
+
+        // Functions that were not materialized are turned into declarations
+        for (Module *Mod : {First.get(), Second.get()}) {
+            for (auto &Fun : *Mod) {
+                if (Fun.isMaterializable()) {
+                    deleteAliasToFun(*Mod, &Fun);
+                    Fun.deleteBody();
+                }
+            }
         }
-        FirstFunName = first_name;
-        SecondFunName = second_name;
-        refreshFunctions();
+        DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                        dbgs() << "Materialized " << Needed.size()
+                               << " functions\n");
     }
-    if (!VariableOpt.empty()) {
-        // Parse --var option - find global variables with given name.
-        FirstVar = First->getGlobalVariable(VariableOpt, true);
-        SecondVar = Second->getGlobalVariable(VariableOpt, true);
+
+    // Finish loading of the modules (this loads everything else that was
+    // loaded lazily, e.g. metadata).
+    for (Module *Mod : {First.get(), Second.get()}) {
+        if (Error E = Mod->materializeAll())
+            logAllUnhandledErrors(std::move(E), errs(),
+                                  "Cannot load " + Mod->getName() + ": ");
     }
-    if (!SuffixOpt.empty()) {
-        // Parse --suffix option - add suffix to the names of output files.
-        FirstOutFile = addSuffix(FirstOutFile, SuffixOpt);
-        SecondOutFile = addSuffix(SecondOutFile, SuffixOpt);
+}
+
+/// Replace the compared modules by new ones. The compared functions and
+/// variables are searched for in the new modules.
+void Config::replaceModules(std::unique_ptr<Module> FirstMod,
+                            std::unique_ptr<Module> SecondMod) {
+    std::string VarName = FirstVar ? FirstVar->getName() : "";
+    First = std::move(FirstMod);
+    Second = std::move(SecondMod);
+    refreshFunctions();
+    if (!VarName.empty())
+        setVariables(VarName);
+}
+
+/// Parse --var option - find global variables with given name.
+void Config::setVariables(const std::string &Var) {
+    FirstVar = First->getGlobalVariable(Var, true);
+    SecondVar = Second->getGlobalVariable(Var, true);
+}
+
+/// Parse --var-list option - read the list of global variables.
+/// The variables are not searched for in the modules since the modules may be
+/// replaced before the slicing is done.
+void Config::setVariableList(const std::string &File) {
+    auto Buffer = MemoryBuffer::getFile(File);
+    if (!Buffer) {
+        errs() << "Cannot read variable list " << File << "\n";
+        return;
     }
-    if (VerboseOpt) {
-        // Enable debugging output in passes
-        DebugFlag = true;
-        setCurrentDebugType(DEBUG_SIMPLL);
+    for (line_iterator Line(**Buffer); !Line.is_at_end(); ++Line) {
+        StringRef Var = Line->trim();
+        if (!Var.empty())
+            VariableList.push_back(Var);
     }
 }
 
+/// Parse --suffix option - add suffix to the names of output files.
+void Config::setOutFileSuffix(const std::string &Suffix) {
+    FirstOutFile = addSuffix(FirstOutFile, Suffix);
+    SecondOutFile = addSuffix(SecondOutFile, Suffix);
+}
+
 void Config::refreshFunctions() {
     FirstFun = First->getFunction(FirstFunName);
     SecondFun = Second->getFunction(SecondFunName);
@@ -28,11 +28,40 @@ using namespace llvm;
 extern cl::opt<std::string> FirstFileOpt;
 extern cl::opt<std::string> SecondFileOpt;
 extern cl::opt<std::string> FunctionOpt;
+extern cl::opt<std::string> FunctionListOpt;
 extern cl::opt<std::string> VariableOpt;
+extern cl::opt<std::string> VariableListOpt;
 extern cl::opt<std::string> SuffixOpt;
 extern cl::opt<bool> ControlFlowOpt;
 extern cl::opt<bool> PrintCallstacksOpt;
 extern cl::opt<bool> VerboseOpt;
+extern cl::opt<std::string> CacheDirOpt;
+extern cl::opt<bool> ParallelOpt;
+extern cl::opt<bool> DropUnreachableOpt;
+extern cl::opt<bool> DropDebugInfoOpt;
+extern cl::opt<bool> VerdictOnlyOpt;
+extern cl::opt<bool> ReportOnlyOpt;
+extern cl::opt<unsigned> MaxInliningRoundsOpt;
+extern cl::opt<unsigned> MaxInliningGrowthOpt;
+extern cl::opt<unsigned> MaxInlinedSizeOpt;
+extern cl::opt<bool> NoResumeOpt;
+extern cl::opt<std::string> FirstLinkIndexOpt;
+extern cl::opt<std::string> SecondLinkIndexOpt;
+extern cl::opt<std::string> SymbolIndexOpt;
+extern cl::opt<bool> ServerOpt;
+extern cl::opt<unsigned> ServerCacheSizeOpt;
+extern cl::opt<bool> StatsOpt;
+
+/// Limits of inlining done when comparing a pair of functions. Sizes are
+/// measured in numbers of instructions, 0 means no limit.
+struct InliningBudget {
+    /// Maximal number of inlining rounds
+    unsigned MaxRounds = 0;
+    /// Maximal number of instructions added to the compared functions
+    unsigned MaxGrowth = 0;
+    /// Maximal size of an inlined function
+    unsigned MaxCalleeSize = 0;
+};
 
 /// Tool configuration parsed from CLI options.
 class Config {
@@ -44,6 +73,17 @@ class Config {
     std::string FirstFunName;
     std::string SecondFunName;
 
+    /// Load bodies of functions that are needed for the comparison.
+    void materializeFunctions();
+    /// Read the list of compared functions from a file (--fun-list option).
+    void setFunctionList(const std::string &File);
+    /// Find the compared global variables.
+    void setVariables(const std::string &Var);
+    /// Read the list of global variables (--var-list option).
+    void setVariableList(const std::string &File);
+    /// Add suffix to the names of the output files.
+    void setOutFileSuffix(const std::string &Suffix);
+
   public:
     // Parsed LLVM modules
     std::unique_ptr<Module> First;
@@ -51,9 +91,15 @@ class Config {
     // Compared functions
     Function *FirstFun = nullptr;
     Function *SecondFun = nullptr;
+    // Compared functions in the batch mode (--fun-list option). Each entry
+    // has the same format as the value of the --fun option.
+    std::vector<std::string> FunctionList;
     // Compared global variables
     GlobalVariable *FirstVar = nullptr;
     GlobalVariable *SecondVar = nullptr;
+    // Global variables in the multi-variable mode (--var-list option). The
+    // compared functions are sliced w.r.t. each of the variables separately.
+    std::vector<std::string> VariableList;
     // Output files
     std::string FirstOutFile;
     std::string SecondOutFile;
@@ -62,8 +108,53 @@ class Config {
     bool ControlFlowOnly;
     // Show call stacks for non-equal functions
     bool PrintCallStacks;
+    // Directory of the persistent cache of comparison results (empty if
+    // the cache is not used)
+    std::string CacheDir;
+    // Preprocess the modules in parallel
+    bool Parallel;
+    // Delete bodies of functions unreachable from the compared functions
+    bool DropUnreachable;
+    // Drop debug metadata of functions unreachable from the compared
+    // functions
+    bool DropDebugInfo;
+    // Do not write the simplified modules if all functions are equal
+    bool VerdictOnly;
+    // Never write the simplified modules, only report the results
+    bool ReportOnly;
+    // Limits of inlining during function comparison
+    InliningBudget Inlining;
+    // Resume comparisons after inlining from the point where the functions
+    // differed (instead of comparing them from the start again)
+    bool ResumeAfterInlining;
+    // Indices of modules used to link missing function definitions (empty if
+    // the definitions should not be linked)
+    std::string FirstLinkIndex;
+    std::string SecondLinkIndex;
 
+    /// Configuration parsed from the command line options.
     Config();
+    /// Configuration for comparing already parsed modules (used by the server
+    /// mode). Options have the same meaning as the corresponding command line
+    /// options.
+    Config(std::unique_ptr<Module> FirstMod,
+           std::unique_ptr<Module> SecondMod,
+           const std::string &FirstFile,
+           const std::string &SecondFile,
+           const std::string &Fun,
+           const std::string &Var,
+           const std::string &Suffix,
+           bool ControlFlowOnly,
+           bool PrintCallStacks);
+
+    /// Set names of the compared functions from the value of the --fun option
+    /// (or from an entry of the function list) and find the functions.
+    void setFunctionNames(const std::string &Fun);
+
+    /// Replace the compared modules (e.g. by their versions with linked
+    /// definitions of missing functions).
+    void replaceModules(std::unique_ptr<Module> FirstMod,
+                        std::unique_ptr<Module> SecondMod);
 
     void refreshFunctions();
 };
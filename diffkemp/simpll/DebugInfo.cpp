@@ -13,8 +13,13 @@
 
 #include "DebugInfo.h"
 #include "Config.h"
+#include "SourceCodeUtils.h"
 #include <llvm/IR/Constants.h>
+#include <llvm/IR/IntrinsicInst.h>
 #include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/Debug.h>
+#include <algorithm>
+#include <chrono>
 
 using namespace llvm;
 
@@ -57,199 +62,154 @@ std::string getStructTypeName(const StructType *type) {
     return name;
 }
 
-DICompositeType *DebugInfo::getStructTypeInfo(const StringRef name,
-                                              const Program prog) const {
-    auto types = prog == Program::First ? DebugInfoFirst.types()
-                                        : DebugInfoSecond.types();
+/// Collect debug info reachable from the given functions of the module.
+/// Unlike DebugInfoFinder::processModule, this does not walk the debug info of
+/// all functions, global variables, and compile units of the module.
+/// For each of the given functions, its subprogram is collected together with
+/// subprograms of the inlined scopes, types of its local variables, and types
+/// of global variables that it uses.
+void DebugInfo::collectDebugInfo(Module &Mod,
+                                 const std::set<const Function *> &Funs,
+                                 CollectedDebugInfo &Info) {
+    for (auto &Fun : Mod) {
+        if (Funs.find(&Fun) == Funs.end())
+            continue;
 
-    for (auto Type : types) {
-        if (auto StructType = dyn_cast<DICompositeType>(Type)) {
-            if (StructType->getName() == name)
-                return StructType;
+        if (auto *Subprogram = Fun.getSubprogram())
+            collectSubprogram(Subprogram, Info);
+
+        for (auto &BB : Fun) {
+            for (auto &Inst : BB) {
+                for (auto *Loc = Inst.getDebugLoc().get(); Loc;
+                     Loc = Loc->getInlinedAt())
+                    collectSubprogram(Loc->getScope()->getSubprogram(), Info);
+
+                if (auto Declare = dyn_cast<DbgDeclareInst>(&Inst))
+                    collectType(Declare->getVariable()->getType().resolve(),
+                                Info);
+                else if (auto DbgValue = dyn_cast<DbgValueInst>(&Inst))
+                    collectType(DbgValue->getVariable()->getType().resolve(),
+                                Info);
+
+                for (auto &Op : Inst.operands()) {
+                    auto Global = dyn_cast<GlobalVariable>(
+                            Op->stripInBoundsOffsets());
+                    if (!Global)
+                        continue;
+                    SmallVector<DIGlobalVariableExpression *, 1> GlobalDIs;
+                    Global->getDebugInfo(GlobalDIs);
+                    for (auto *GlobalDI : GlobalDIs)
+                        collectType(
+                                GlobalDI->getVariable()->getType().resolve(),
+                                Info);
+                }
+            }
         }
     }
-    return nullptr;
+    DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                    dbgs() << "Collected debug info of " << Mod.getName()
+                           << ": " << Info.CompileUnits.size()
+                           << " compile units, " << Info.Subprograms.size()
+                           << " subprograms, " << Info.Types.size()
+                           << " types\n");
 }
 
-/// Calculate alignments of the corresponding indices for one GEP
-/// instruction.
-void DebugInfo::extractAlignmentFromInstructions(GetElementPtrInst *GEP,
-                                                 GetElementPtrInst *OtherGEP) {
-    if (GEP) {
-        std::vector<Value *> indices;
-        std::vector<Value *> indicesOther;
-
-        User::op_iterator idx_other;
-        if (OtherGEP)
-             // If we have the other GEP, iterate over its indices, too
-             idx_other = OtherGEP->idx_begin();
-
-        // Iterate all indices
-        for (auto idx = GEP->idx_begin();
-                idx != GEP->idx_end();
-                ++idx, indices.push_back(*idx)) {
-            auto indexedType = GEP->getIndexedType(GEP->getSourceElementType(),
-                                                   ArrayRef<Value *>(indices));
-
-            Type *indexedTypeOther = nullptr;
-            if (OtherGEP)
-                indexedTypeOther = OtherGEP->getIndexedType(
-                                        OtherGEP->getSourceElementType(),
-                                        ArrayRef<Value *>(
-                                            indicesOther));
-
-            if (!indexedType->isStructTy())
-                continue;
-
-            if (indexedTypeOther && !indexedTypeOther->isStructTy()) {
-                // The type in the corresponding GEP instruction is different,
-                // therefore it cannot be used
-                indexedTypeOther = nullptr;
-            }
-
-            auto &indexMap = IndexMaps[dyn_cast<StructType>(indexedType)];
-
-            if (auto IndexConstant = dyn_cast<ConstantInt>(*idx)) {
-                // Numeric value of the current index
-                uint64_t indexFirst = IndexConstant->getZExtValue();
-
-                // Check if the corresponding index already exists
-                auto otherIndex = indexMap.find(indexFirst);
-                if (otherIndex != indexMap.end()) {
-                    if (indexFirst != otherIndex->second) {
-                        setNewAlignmentOfIndex(
-                                *GEP,
-                                indices.size(),
-                                otherIndex->second,
-                                IndexConstant->getBitWidth(),
-                                ModFirst.getContext());
-                    }
-                    continue;
-                }
-
-                indexMap.emplace(indexFirst, indexFirst);
-
-                // Name of the current type (type being indexed)
-                if (!dyn_cast<StructType>(indexedType)->hasName())
-                    continue;
-                std::string typeName = getStructTypeName(
-                        dyn_cast<StructType>(indexedType));
-
-                // Get name of the element at the current index in
-                // the first module
-                auto TypeDIFirst = getStructTypeInfo(typeName, Program::First);
-                if (!TypeDIFirst)
-                    continue;
-
-                StringRef elementName = getElementNameAtIndex(*TypeDIFirst,
-                                                              indexFirst);
-
-                // Find index of the element with the same name in
-                // the second module
-                auto TypeDISecond = getStructTypeInfo(typeName,
-                                                      Program::Second);
-                if (!TypeDISecond)
-                    continue;
-
-                int indexSecond = getTypeMemberIndex(*TypeDISecond,
-                                                     elementName);
-
-                // If indices do not match, align the first one to
-                // be the same as the second one
-                if (indexSecond > 0 && indexFirst != indexSecond) {
-                    indexMap.at(indexFirst) =
-                            (unsigned) indexSecond;
-                    setNewAlignmentOfIndex(
-                            *GEP, indices.size(),
-                            (unsigned) indexSecond,
-                            IndexConstant->getBitWidth(),
-                            ModFirst.getContext());
-
-                    DEBUG_WITH_TYPE(DEBUG_SIMPLL, GEP->print(dbgs()));
-
-                    StructFieldNames.insert(
-                        {{dyn_cast<StructType>(indexedType),
-                            indexFirst}, elementName});
-
-                    if (indexedTypeOther)
-                        StructFieldNames.insert(
-                            {{dyn_cast<StructType>(indexedTypeOther),
-                                indexSecond}, elementName});
-                    else
-                        StructFieldNames.insert(
-                            {{ModSecond.getTypeByName(
-                                    indexedType->getStructName()),
-                        indexSecond}, elementName});
-
-                    DEBUG_WITH_TYPE(DEBUG_SIMPLL,
-                                    dbgs() << "New index: " << indexSecond
-                                           << "\n");
-                }
-            }
+/// Add the subprogram, its compile unit, and its type to the info.
+void DebugInfo::collectSubprogram(DISubprogram *Subprogram,
+                                  CollectedDebugInfo &Info) {
+    if (!Subprogram || !Info.Subprograms.insert(Subprogram).second)
+        return;
 
-            if (OtherGEP && idx_other != OtherGEP->idx_end()) {
-                indicesOther.push_back(*idx_other);
-                ++idx_other;
-            }
-        }
+    if (auto *Unit = Subprogram->getUnit()) {
+        if (std::find(Info.CompileUnits.begin(), Info.CompileUnits.end(),
+                      Unit) == Info.CompileUnits.end())
+            Info.CompileUnits.push_back(Unit);
     }
+    collectType(Subprogram->getType(), Info);
 }
 
-/// For each GEP instruction, check if the accessed struct members of
-/// the same name have the same alignment in both modules. If not, add
-/// metadata to the instruction of one module containing new value of
-/// the alignment
-void DebugInfo::calculateGEPIndexAlignments() {
-    // Check if any debug info was collected
-    if (DebugInfoFirst.type_count() == 0 || DebugInfoSecond.type_count() == 0)
+/// Add the type and all types that it refers to (base types, types of
+/// elements of composite types, and types of parameters of subroutine types)
+/// to the info. Named composite types are indexed by their names.
+void DebugInfo::collectType(DIType *Type, CollectedDebugInfo &Info) {
+    if (!Type || !Info.Types.insert(Type).second)
         return;
 
-    for (auto &Fun : ModFirst) {
-        auto OtherFun = ModSecond.getFunction(Fun.getName());
-        if (!OtherFun)
-            continue;
+    if (auto *Subroutine = dyn_cast<DISubroutineType>(Type)) {
+        for (auto TypeRef : Subroutine->getTypeArray())
+            collectType(TypeRef.resolve(), Info);
+    } else if (auto *Composite = dyn_cast<DICompositeType>(Type)) {
+        if (!Composite->getName().empty())
+            Info.StructTypes.insert({Composite->getName(), Composite});
+        collectType(Composite->getBaseType().resolve(), Info);
+        for (auto *Elem : Composite->getElements()) {
+            if (auto *ElemType = dyn_cast<DIType>(Elem))
+                collectType(ElemType, Info);
+        }
+    } else if (auto *Derived = dyn_cast<DIDerivedType>(Type)) {
+        collectType(Derived->getBaseType().resolve(), Info);
+    }
+}
 
-        if (CalledFirst.find(&Fun) == CalledFirst.end())
-            continue;
+/// Get debug info for struct type with given name.
+DICompositeType *DebugInfo::getStructTypeInfo(const StringRef name,
+                                              const Program prog) const {
+    auto &Info = prog == Program::First ? DebugInfoFirst : DebugInfoSecond;
+    return Info.StructTypes.lookup(name);
+}
 
-        auto OtherBB = OtherFun->begin();
-        for (auto &BB : Fun) {
-            if (OtherBB != OtherFun->end()) {
-                // The other basic block is available; iterate over its
-                // instructions and try to find the corresponding GEP
-                // instructions
-                auto OtherInstr = OtherBB->begin();
-
-                for (auto &Instr : BB) {
-                    auto GEP = dyn_cast<GetElementPtrInst>(&Instr);
-
-                    if (OtherInstr != OtherBB->end()) {
-                        // The other instruction is available; try to get the
-                        // corresponding GEP instruction
-                        auto OtherGEP = dyn_cast<GetElementPtrInst>(
-                            &*OtherInstr);
-
-                        extractAlignmentFromInstructions(GEP, OtherGEP);
-
-                        ++OtherInstr;
-                    } else
-                        // The end of the basic block has been reached in the
-                        // other module, so the other GEP parameter can't be
-                        // used
-                        extractAlignmentFromInstructions(GEP, nullptr);
-                }
+/// Get name of the field at the given index of the structure type. The name
+/// is taken from the debug info of the program that the type comes from and
+/// it is memoised for each type and index.
+StringRef DebugInfo::getFieldName(StructType *Type,
+                                  uint64_t Index,
+                                  Program Prog) const {
+    auto Cached = FieldNames.find({Type, Index});
+    if (Cached != FieldNames.end())
+        return Cached->second;
+
+    StringRef Name;
+    if (Type->hasName()) {
+        if (auto TypeDI = getStructTypeInfo(getStructTypeName(Type), Prog))
+            Name = getElementNameAtIndex(*TypeDI, Index);
+    }
+    FieldNames.insert({{Type, Index}, Name});
+    return Name;
+}
 
-                ++OtherBB;
-            } else {
-                // The other basic block is not available - iterate the
-                // standard way without instructions in the other module
-                for (auto &Instr : BB) {
-                    auto GEP = dyn_cast<GetElementPtrInst>(&Instr);
-                    extractAlignmentFromInstructions(GEP, nullptr);
-                }
-            }
-        }
+/// Check if the fields at the given indices of the structure types correspond
+/// to each other, i.e. if the field of the second type at IndexR has the same
+/// name as the field of the first type at IndexL.
+/// The index of the corresponding field in the second type is computed only
+/// when it is first needed and then it is memoised for the pair of types.
+bool DebugInfo::fieldsCorrespond(StructType *TypeL,
+                                 uint64_t IndexL,
+                                 StructType *TypeR,
+                                 uint64_t IndexR) const {
+    // Check if any debug info was collected
+    if (DebugInfoFirst.Types.empty() || DebugInfoSecond.Types.empty())
+        return false;
+    if (!TypeL->hasName() || !TypeR->hasName())
+        return false;
+
+    auto &IndexMap = FieldIndexMaps[{TypeL, TypeR}];
+    auto Aligned = IndexMap.find(IndexL);
+    if (Aligned == IndexMap.end()) {
+        int IndexSecond = -1;
+        StringRef ElementName = getFieldName(TypeL, IndexL, Program::First);
+        if (auto TypeDISecond = getStructTypeInfo(getStructTypeName(TypeR),
+                                                  Program::Second))
+            IndexSecond = getTypeMemberIndex(*TypeDISecond, ElementName);
+        Aligned = IndexMap.insert({IndexL, IndexSecond}).first;
+
+        if (IndexSecond > 0 && IndexL != (uint64_t)IndexSecond)
+            DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                            dbgs() << "Field " << ElementName << " of "
+                                   << TypeL->getName() << " aligned from "
+                                   << IndexL << " to " << IndexSecond
+                                   << "\n");
     }
+    return Aligned->second > 0 && (uint64_t)Aligned->second == IndexR;
 }
 
 /// Check if a struct element is at the same offset as the previous element. Th
@@ -319,26 +279,18 @@ StringRef DebugInfo::getElementNameAtIndex(const DICompositeType &type,
     return "";
 }
 
-/// Add metadata with the new offset to the GEP instruction
-void DebugInfo::setNewAlignmentOfIndex(GetElementPtrInst &GEP,
-                                       unsigned long index,
-                                       uint64_t alignment,
-                                       unsigned bitWidth,
-                                       LLVMContext &c) {
-    MDNode *MD = MDNode::get(c, ConstantAsMetadata::get(
-            ConstantInt::get(c, APInt(bitWidth, alignment, false))));
-    GEP.setMetadata("idx_align_" + std::to_string(index), MD);
-}
-
 /// Collects mappings of values for constants that are potentially generated
 /// from macros. It finds all used constants that correpond to some macro value
 /// in the first module and then finds values or given macros in the second
 /// module. If the values differ, a mapping is created for the constant.
 void DebugInfo::calculateMacroAlignments() {
     // Check if any debug info was collected
-    if (DebugInfoFirst.type_count() == 0 || DebugInfoSecond.type_count() == 0)
+    if (DebugInfoFirst.Types.empty() || DebugInfoSecond.Types.empty())
         return;
 
+    auto StartTime = std::chrono::steady_clock::now();
+    buildMacroValueIndex();
+
     // Find all constants used in the first module whose values correspond to
     // some macro value.
     for (auto &Fun : ModFirst) {
@@ -352,9 +304,8 @@ void DebugInfo::calculateMacroAlignments() {
             for (const auto &Inst : BB) {
                 for (const auto &Op : Inst.operands()) {
                     if (auto Const = dyn_cast<Constant>(&Op)) {
-                        if (VisitedConsts.find(Const) == VisitedConsts.end())
-                            VisitedConsts.insert(Const);
-                        collectMacrosWithValue(Const);
+                        if (VisitedConsts.insert(Const).second)
+                            collectMacrosWithValue(Const);
                     }
                 }
             }
@@ -363,7 +314,7 @@ void DebugInfo::calculateMacroAlignments() {
 
     // In second module, search for macros collected in the previous step and
     // if they have a different value between the modules, create a mapping.
-    for (auto *CompileUnit : DebugInfoSecond.compile_units()) {
+    for (auto *CompileUnit : DebugInfoSecond.CompileUnits) {
         for (auto *MacroNode : CompileUnit->getMacros()) {
             if (auto *Macro = dyn_cast<DIMacro>(MacroNode)) {
                 addAlignment(Macro->getName(), Macro->getValue());
@@ -378,35 +329,49 @@ void DebugInfo::calculateMacroAlignments() {
             }
         }
     }
-}
 
-/// Find all macros and enum values that define a value corresponding to the
-/// value of the given constant and add them to the MacroUsageMap.
-void DebugInfo::collectMacrosWithValue(const Constant *Val) {
-    std::string valStr = valueAsString(Val);
-    if (valStr.empty())
-        return;
+    auto Duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - StartTime);
+    DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                    dbgs() << "Macro alignment took " << Duration.count()
+                           << " ms (" << MacroConstantMap.size()
+                           << " aligned constants)\n");
+}
 
-    for (auto *CompileUnit : DebugInfoFirst.compile_units()) {
-        for (auto *MacroNode : CompileUnit->getMacros()) {
-            if (auto *Macro = dyn_cast<DIMacro>(MacroNode)) {
-                if (Macro->getValue() == valStr) {
-                    MacroUsageMap[Macro->getName()].insert(Val);
-                }
-            }
+/// Build the index of names of macros and enum values of the first module by
+/// their values. Macros are taken from the macro index of each compile unit.
+void DebugInfo::buildMacroValueIndex() {
+    for (auto *CompileUnit : DebugInfoFirst.CompileUnits) {
+        for (auto &Macros : getMacroIndex(CompileUnit).UnitMacrosByValue) {
+            auto &Names = MacroNamesByValue[Macros.first()];
+            Names.insert(Names.end(), Macros.second.begin(),
+                         Macros.second.end());
         }
         for (auto *Enum : CompileUnit->getEnumTypes()) {
             for (auto *EnumField : Enum->getElements()) {
                 if (auto *Enumerator = dyn_cast<DIEnumerator>(EnumField)) {
-                    if (std::to_string(Enumerator->getValue()) == valStr) {
-                        MacroUsageMap[Enumerator->getName()].insert(Val);
-                    }
+                    MacroNamesByValue[std::to_string(Enumerator->getValue())]
+                            .push_back(Enumerator->getName());
                 }
             }
         }
     }
 }
 
+/// Find all macros and enum values that define a value corresponding to the
+/// value of the given constant and add them to the MacroUsageMap.
+void DebugInfo::collectMacrosWithValue(const Constant *Val) {
+    std::string valStr = valueAsString(Val);
+    if (valStr.empty())
+        return;
+
+    auto Names = MacroNamesByValue.find(valStr);
+    if (Names == MacroNamesByValue.end())
+        return;
+    for (auto Name : Names->second)
+        MacroUsageMap[Name].insert(Val);
+}
+
 /// Add alignment for the given macro name and value from the second module.
 /// Checks if a macro with the given name was used in the first module (by
 /// querying the MacroUsageMap). If yes, and the macro value is different in
@@ -422,16 +387,37 @@ void DebugInfo::addAlignment(std::string MacroName, std::string MacroValue) {
     }
 }
 
-/// Remove calls to debug info intrinsics from all functions in the module.
+/// Remove calls to debug info intrinsics from the given functions of the
+/// module. Other functions are never compared, hence they can be skipped.
 /// We do not use LLVM's stripDebugInfo functions here since they remove other
 /// information that we need later (particularly file names).
-void DebugInfo::removeFunctionsDebugInfo(Module &Mod) {
+void DebugInfo::removeFunctionsDebugInfo(
+        Module &Mod, const std::set<const Function *> &Funs) {
     // Function passes
     PassBuilder pb;
     FunctionPassManager fpm(false);
     FunctionAnalysisManager fam(false);
     pb.registerFunctionAnalyses(fam);
     fpm.addPass(RemoveDebugInfoPass {});
-    for (auto &F : Mod)
-        fpm.run(F, fam);
+    for (auto &F : Mod) {
+        if (Funs.find(&F) != Funs.end())
+            fpm.run(F, fam);
+    }
+}
+
+/// Drop debug metadata (debug info intrinsics, locations, and subprogram
+/// attachments) of the functions of the module that are not among the given
+/// functions. These functions are never compared, so the metadata would only
+/// occupy memory.
+void DebugInfo::dropUnreachableDebugInfo(
+        Module &Mod, const std::set<const Function *> &Funs) {
+    unsigned Dropped = 0;
+    for (auto &F : Mod) {
+        if (Funs.find(&F) == Funs.end() && stripDebugInfo(F))
+            Dropped++;
+    }
+    DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                    dbgs() << "Dropped debug info of " << Dropped
+                           << " unreachable functions of " << Mod.getName()
+                           << "\n");
 }
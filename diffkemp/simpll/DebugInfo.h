@@ -16,10 +16,12 @@
 #define DIFFKEMP_SIMPLL_DEBUGINFO_H
 
 #include "Utils.h"
+#include <llvm/ADT/StringMap.h>
 #include <llvm/IR/DebugInfo.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/PassManager.h>
 #include <llvm/IR/TypeFinder.h>
+#include <map>
 #include <set>
 #include <llvm/IR/ValueMap.h>
 
@@ -30,64 +32,120 @@ using namespace llvm;
 /// 1. Alignment of GEP indices.
 ///    In case the corresponding structure has a different set of fields between
 ///    the analysed modules, it might happen that corresponding fields are at
-///    different indices. This analysis matches fields with same name and saves
-///    the index offset into the metadata of a GEP instruction.
+///    different indices. Fields with the same name are matched on demand,
+///    when the comparator finds GEPs whose indices differ.
+/// 2. Alignment of macros.
+///    Constants of the first module that may come from a macro whose value
+///    differs in the second module are mapped to the new value.
+/// Only debug info reachable from the functions that may be compared (i.e.
+/// functions called from the compared functions) is processed.
 class DebugInfo {
   public:
-    using StructFieldNamesMap = std::map<std::pair<StructType *, uint64_t>,
-                                         StringRef>;
+    /// \param CalledFirst Functions of the first module that may be compared.
+    /// \param CalledSecond Functions of the second module that may be
+    ///                     compared.
+    /// \param DropUnreachable Drop debug metadata of the functions that cannot
+    ///                        be compared.
     DebugInfo(Module &modFirst, Module &modSecond,
               Function *funFirst, Function *funSecond,
-              std::set<const Function *> &CalledFirst) :
+              std::set<const Function *> &CalledFirst,
+              std::set<const Function *> &CalledSecond,
+              bool DropUnreachable = false) :
             FunFirst(funFirst), FunSecond(funSecond),
             ModFirst(modFirst), ModSecond(modSecond),
-            CalledFirst(CalledFirst) {
-        DebugInfoFirst.processModule(ModFirst);
-        DebugInfoSecond.processModule(ModSecond);
+            CalledFirst(CalledFirst), CalledSecond(CalledSecond) {
+        collectDebugInfo(ModFirst, CalledFirst, DebugInfoFirst);
+        collectDebugInfo(ModSecond, CalledSecond, DebugInfoSecond);
         // Use debug info to gather useful information
-        calculateGEPIndexAlignments();
         calculateMacroAlignments();
         // Remove calls to debug info intrinsics from the functions - it may
         // cause some non-equalities in FunctionComparator.
-        removeFunctionsDebugInfo(modFirst);
-        removeFunctionsDebugInfo(modSecond);
+        removeFunctionsDebugInfo(modFirst, CalledFirst);
+        removeFunctionsDebugInfo(modSecond, CalledSecond);
+        if (DropUnreachable) {
+            dropUnreachableDebugInfo(modFirst, CalledFirst);
+            dropUnreachableDebugInfo(modSecond, CalledSecond);
+        }
     };
 
-    /// Maps structure type and index to struct member names
-    StructFieldNamesMap StructFieldNames;
-
     /// Maps constants potentially generated from a macro from the first module
     /// to corresponding values in the second module.
     std::map<const Constant *, std::string> MacroConstantMap;
 
+    /// Get name of the field at the given index of the structure type.
+    /// \param Type Structure type from the module of the given program.
+    /// \param Index Index of the field.
+    /// \param Prog Program that the type comes from.
+    /// \return Name of the field or an empty string if it is not known.
+    StringRef getFieldName(StructType *Type,
+                           uint64_t Index,
+                           Program Prog) const;
+
+    /// Check if the field at IndexL of TypeL (from the first module)
+    /// corresponds to the field at IndexR of TypeR (from the second module).
+    /// Fields correspond if they have the same name.
+    bool fieldsCorrespond(StructType *TypeL,
+                          uint64_t IndexL,
+                          StructType *TypeR,
+                          uint64_t IndexR) const;
+
   private:
     Function *FunFirst;
     Function *FunSecond;
     Module &ModFirst;
     Module &ModSecond;
-    DebugInfoFinder DebugInfoFirst;
-    DebugInfoFinder DebugInfoSecond;
     std::set<const Function *> &CalledFirst;
+    std::set<const Function *> &CalledSecond;
+
+    /// Debug info collected from a subset of functions of a module.
+    struct CollectedDebugInfo {
+        /// Compile units of the functions
+        std::vector<DICompileUnit *> CompileUnits;
+        /// All visited subprograms and types
+        std::set<const DISubprogram *> Subprograms;
+        std::set<const DIType *> Types;
+        /// Struct types indexed by their names
+        StringMap<DICompositeType *> StructTypes;
+    };
+    CollectedDebugInfo DebugInfoFirst;
+    CollectedDebugInfo DebugInfoSecond;
 
-    /// Mapping struct types to index maps that contain pairs of corresponding
-    /// indices.
-    std::map<StructType *, std::map<uint64_t, uint64_t>> IndexMaps;
+    /// Names of struct fields indexed by the struct type and the field index.
+    mutable std::map<std::pair<StructType *, uint64_t>, StringRef> FieldNames;
+
+    /// Mapping pairs of struct types to index maps that contain indices of
+    /// the corresponding fields in the second type (-1 if there is no such
+    /// field).
+    mutable std::map<std::pair<StructType *, StructType *>,
+                     std::map<uint64_t, int>> FieldIndexMaps;
 
     /// Mapping macro names to the set of constants in the first module having
     /// the macro value.
     std::map<std::string, std::set<const Constant *>> MacroUsageMap;
 
-    /// Calculate alignments of the corresponding indices for one GEP
-    /// instruction.
-    void extractAlignmentFromInstructions(GetElementPtrInst *GEPL,
-                                          GetElementPtrInst *GEPR);
+    /// Names of macros and enum values of the first module indexed by their
+    /// values.
+    StringMap<std::vector<StringRef>> MacroNamesByValue;
+
+    /// Collect compile units, subprograms, and types reachable from the
+    /// given functions of the module.
+    static void collectDebugInfo(Module &Mod,
+                                 const std::set<const Function *> &Funs,
+                                 CollectedDebugInfo &Info);
 
-    /// Calculate alignments of the corresponding indices of GEP instructions.
-    void calculateGEPIndexAlignments();
+    /// Add the subprogram (and its compile unit and type) to the info.
+    static void collectSubprogram(DISubprogram *Subprogram,
+                                  CollectedDebugInfo &Info);
+
+    /// Add the type and all types that it refers to to the info.
+    static void collectType(DIType *Type, CollectedDebugInfo &Info);
 
     /// Calculate alignments of the corresponding macros
     void calculateMacroAlignments();
 
+    /// Index macros and enum values of the first module by their values
+    void buildMacroValueIndex();
+
     /// Find all macros in the first module having the given value
     void collectMacrosWithValue(const Constant *Val);
 
@@ -113,24 +171,19 @@ class DebugInfo {
     static StringRef getElementNameAtIndex(const DICompositeType &type,
                                            uint64_t index);
 
-    /// Add metadata with the new offset to the GEP instruction
-    /// \param GEP GEP instruction.
-    /// \param index GEP instruction index.
-    /// \param alignment New alignment.
-    /// \param bitWidth Alignment bit width.
-    /// \param c LLVM context.
-    static void setNewAlignmentOfIndex(GetElementPtrInst &GEP,
-                                       unsigned long index,
-                                       uint64_t alignment,
-                                       unsigned bitWidth,
-                                       LLVMContext &c);
-
     /// Check if the struct element has the same index as the previous element
     /// (this situation may be caused by the compiler due to struct alignment).
     static bool isSameElemIndex(const DIDerivedType *TypeElem);
 
-    /// Remove calls to debug info intrinsics from all functions in the module.
-    void removeFunctionsDebugInfo(Module &Mod);
+    /// Remove calls to debug info intrinsics from the given functions of
+    /// the module.
+    void removeFunctionsDebugInfo(Module &Mod,
+                                  const std::set<const Function *> &Funs);
+
+    /// Drop debug metadata of functions of the module that are not among
+    /// the given functions.
+    void dropUnreachableDebugInfo(Module &Mod,
+                                  const std::set<const Function *> &Funs);
 };
 
 /// A pass to remove all debugging information from a function.
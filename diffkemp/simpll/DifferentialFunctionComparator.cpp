@@ -15,6 +15,7 @@
 #include "DifferentialFunctionComparator.h"
 #include "Config.h"
 #include "SourceCodeUtils.h"
+#include "Stats.h"
 #include "passes/FunctionAbstractionsGenerator.h"
 #include <llvm/IR/GetElementPtrTypeIterator.h>
 #include <llvm/IR/Instructions.h>
@@ -28,10 +29,186 @@ std::set<std::string> ignoredMacroList = {
         "__COUNTER__", "__FILE__", "__LINE__", "__DATE__", "__TIME__"
 };
 
+/// Record an instruction of a basic block from the equal prefix.
+static ComparisonCheckpoint::InstSnapshot recordInst(const Instruction &Inst) {
+    ComparisonCheckpoint::InstSnapshot Snapshot;
+    Snapshot.Inst = const_cast<Instruction *>(&Inst);
+    for (auto &Op : Inst.operands())
+        Snapshot.Operands.emplace_back(Op.get());
+    Snapshot.OptionalData = Inst.getRawSubclassOptionalData();
+    Inst.getAllMetadata(Snapshot.Metadata);
+    return Snapshot;
+}
+
+/// Check that the basic block contains exactly the recorded instructions
+/// having the recorded operands, flags, and metadata.
+static bool isBlockUnchanged(
+        const Value *Block,
+        const std::vector<ComparisonCheckpoint::InstSnapshot> &Insts) {
+    if (!Block)
+        return false;
+    auto Snapshot = Insts.begin();
+    for (auto &Inst : *cast<BasicBlock>(Block)) {
+        if (Snapshot == Insts.end() || Snapshot->Inst != &Inst ||
+                Snapshot->Operands.size() != Inst.getNumOperands() ||
+                Snapshot->OptionalData != Inst.getRawSubclassOptionalData())
+            return false;
+        for (unsigned i = 0; i < Inst.getNumOperands(); i++) {
+            if (Snapshot->Operands[i] != Inst.getOperand(i))
+                return false;
+        }
+        SmallVector<std::pair<unsigned, MDNode *>, 4> Metadata;
+        Inst.getAllMetadata(Metadata);
+        if (Metadata != Snapshot->Metadata)
+            return false;
+        ++Snapshot;
+    }
+    return Snapshot == Insts.end();
+}
+
+/// Check that the recorded prefix and the pending blocks did not change.
+/// Deleted values are detected by the value handles becoming null.
+bool ComparisonCheckpoint::isUnchanged() const {
+    if (!Valid)
+        return false;
+    for (auto &Block : Prefix) {
+        if (!isBlockUnchanged(Block.BlockL, Block.InstsL) ||
+                !isBlockUnchanged(Block.BlockR, Block.InstsR))
+            return false;
+    }
+    for (auto &Blocks : Pending) {
+        if (!Blocks.first || !Blocks.second)
+            return false;
+    }
+    return true;
+}
+
+/// Compare the functions. This is the CFG-ordered walk of
+/// FunctionComparator::compare that can start from a checkpoint of a previous
+/// comparison of the same functions. Since the walk and the numbering of
+/// values depend only on the already compared blocks, resuming gives the same
+/// result as comparing from the entry blocks.
+int DifferentialFunctionComparator::compare() {
+    beginCompare();
+    ErasedSerialNumbers = false;
+
+    if (int Res = compareSignature())
+        return Res;
+
+    SmallVector<const BasicBlock *, 8> FnLBBs, FnRBBs;
+    SmallPtrSet<const BasicBlock *, 32> VisitedBBs; // in terms of F1.
+    // Pairs of equal blocks compared in this run
+    std::vector<std::pair<const BasicBlock *, const BasicBlock *>> Equal;
+
+    if (Checkpoint && Checkpoint->isUnchanged()) {
+        DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                        dbgs() << "Resuming comparison of " << FnL->getName()
+                               << " after " << Checkpoint->Prefix.size()
+                               << " equal blocks\n");
+        sn_mapL = Checkpoint->SerialNumbersL;
+        sn_mapR = Checkpoint->SerialNumbersR;
+        for (auto &Block : Checkpoint->Prefix)
+            VisitedBBs.insert(cast<BasicBlock>(Block.BlockL));
+        for (auto &Blocks : Checkpoint->Pending) {
+            FnLBBs.push_back(cast<BasicBlock>(Blocks.first));
+            FnRBBs.push_back(cast<BasicBlock>(Blocks.second));
+            VisitedBBs.insert(FnLBBs.back());
+        }
+    } else {
+        if (Checkpoint) {
+            Checkpoint->Valid = false;
+            Checkpoint->Prefix.clear();
+        }
+        FnLBBs.push_back(&FnL->getEntryBlock());
+        FnRBBs.push_back(&FnR->getEntryBlock());
+        VisitedBBs.insert(FnLBBs[0]);
+    }
+
+    while (!FnLBBs.empty()) {
+        const BasicBlock *BBL = FnLBBs.pop_back_val();
+        const BasicBlock *BBR = FnRBBs.pop_back_val();
+        unsigned SerialNumbersL = sn_mapL.size();
+        unsigned SerialNumbersR = sn_mapR.size();
+
+        int Res = cmpValues(BBL, BBR);
+        if (!Res)
+            Res = cmpBasicBlocks(BBL, BBR);
+        if (Res) {
+            if (Checkpoint) {
+                FnLBBs.push_back(BBL);
+                FnRBBs.push_back(BBR);
+                createCheckpoint(Equal, FnLBBs, FnRBBs, SerialNumbersL,
+                                 SerialNumbersR);
+            }
+            return Res;
+        }
+        Equal.emplace_back(BBL, BBR);
+
+        const TerminatorInst *TermL = BBL->getTerminator();
+        const TerminatorInst *TermR = BBR->getTerminator();
+
+        assert(TermL->getNumSuccessors() == TermR->getNumSuccessors());
+        for (unsigned i = 0, e = TermL->getNumSuccessors(); i != e; ++i) {
+            if (!VisitedBBs.insert(TermL->getSuccessor(i)).second)
+                continue;
+
+            FnLBBs.push_back(TermL->getSuccessor(i));
+            FnRBBs.push_back(TermR->getSuccessor(i));
+        }
+    }
+    return 0;
+}
+
+/// Record the state of the comparison into the checkpoint. Blocks that were
+/// found equal in this run are appended to the prefix and serial numbers
+/// assigned after the prefix was compared are dropped.
+void DifferentialFunctionComparator::createCheckpoint(
+        const std::vector<std::pair<const BasicBlock *,
+                                    const BasicBlock *>> &Equal,
+        const SmallVectorImpl<const BasicBlock *> &PendingL,
+        const SmallVectorImpl<const BasicBlock *> &PendingR,
+        unsigned SerialNumbersL, unsigned SerialNumbersR) {
+    Checkpoint->Valid = !ErasedSerialNumbers;
+    if (!Checkpoint->Valid) {
+        Checkpoint->Prefix.clear();
+        return;
+    }
+
+    for (auto &Blocks : Equal) {
+        ComparisonCheckpoint::BlockSnapshot Snapshot;
+        Snapshot.BlockL = const_cast<BasicBlock *>(Blocks.first);
+        Snapshot.BlockR = const_cast<BasicBlock *>(Blocks.second);
+        for (auto &Inst : *Blocks.first)
+            Snapshot.InstsL.push_back(recordInst(Inst));
+        for (auto &Inst : *Blocks.second)
+            Snapshot.InstsR.push_back(recordInst(Inst));
+        Checkpoint->Prefix.push_back(std::move(Snapshot));
+    }
+
+    Checkpoint->SerialNumbersL.clear();
+    for (auto &Number : sn_mapL) {
+        if ((unsigned)Number.second < SerialNumbersL)
+            Checkpoint->SerialNumbersL.insert(Number);
+    }
+    Checkpoint->SerialNumbersR.clear();
+    for (auto &Number : sn_mapR) {
+        if ((unsigned)Number.second < SerialNumbersR)
+            Checkpoint->SerialNumbersR.insert(Number);
+    }
+
+    Checkpoint->Pending.clear();
+    for (unsigned i = 0; i < PendingL.size(); i++) {
+        Checkpoint->Pending.emplace_back(
+                const_cast<BasicBlock *>(PendingL[i]),
+                const_cast<BasicBlock *>(PendingR[i]));
+    }
+}
+
 /// Compare GEPs. This code is copied from FunctionComparator::cmpGEPs since it
 /// was not possible to simply call the original function.
 /// Handles offset between matching GEP indices in the compared modules.
-/// Uses data saved in StructFieldNames.
+/// Correspondence of struct fields at differing indices is found using debug
+/// info (only for the indices that actually differ).
 int DifferentialFunctionComparator::cmpGEPs(
         const GEPOperator *GEPL,
         const GEPOperator *GEPR) const {
@@ -100,21 +277,15 @@ int DifferentialFunctionComparator::cmpGEPs(
                 continue;
             }
 
-            // The indexed type is a structure type - compare the names of the
-            // structure members from StructFieldNames.
-            auto MemberNameL = DI->StructFieldNames.find(
-                {dyn_cast<StructType>(ValueTypeL),
-                NumericIndexL.getZExtValue()});
-
-            auto MemberNameR = DI->StructFieldNames.find(
-                {dyn_cast<StructType>(ValueTypeR),
-                NumericIndexR.getZExtValue()});
-
-            if (MemberNameL == DI->StructFieldNames.end() ||
-                MemberNameR == DI->StructFieldNames.end() ||
-                !MemberNameL->second.equals(MemberNameR->second))
-                if (int Res = cmpValues(idxL->get(), idxR->get()))
+            // The indexed type is a structure type - if the indices differ,
+            // check whether they refer to fields having the same name.
+            if (int Res = cmpValues(idxL->get(), idxR->get())) {
+                if (!DI->fieldsCorrespond(dyn_cast<StructType>(ValueTypeL),
+                                          NumericIndexL.getZExtValue(),
+                                          dyn_cast<StructType>(ValueTypeR),
+                                          NumericIndexR.getZExtValue()))
                     return Res;
+            }
 
             IndicesL.push_back(*idxL);
             IndicesR.push_back(*idxR);
@@ -164,6 +335,7 @@ int DifferentialFunctionComparator::cmpAttrs(const AttributeList L,
 /// standard comparison returns something other than zero.
 int DifferentialFunctionComparator::cmpOperations(
     const Instruction *L, const Instruction *R, bool &needToCmpOperands) const {
+    countStat(Counter::InstructionsCompared);
     int Result = FunctionComparator::cmpOperations(L, R, needToCmpOperands);
 
     // Check whether the instruction is a call instruction.
@@ -386,6 +558,7 @@ int DifferentialFunctionComparator::cmpBasicBlocks(const BasicBlock *BBL,
                 // Reset serial counters
                 sn_mapL.erase(&*InstL);
                 sn_mapR.erase(&*InstR);
+                ErasedSerialNumbers = true;
                 // One of the compared operations will be skipped and the
                 // comparison will be repeated.
                 if (mayIgnore(&*InstL))
@@ -456,18 +629,16 @@ int DifferentialFunctionComparator::cmpBasicBlocks(const BasicBlock *BBL,
                             // Both arguments are sizeofs; look whether they
                             // correspond to a changed size of the same
                             // structure
-                            int IntL =
+                            uint64_t IntL =
                                 dyn_cast<ConstantInt>(OpL)->getZExtValue();
-                            int IntR =
+                            uint64_t IntR =
                                 dyn_cast<ConstantInt>(OpR)->getZExtValue();
-                            auto SizeL = ModComparator->StructSizeMapL.find(
+                            auto SizeL = ModComparator->StructSizeMapL.lookup(
                                 IntL);
-                            auto SizeR = ModComparator->StructSizeMapR.find(
+                            auto SizeR = ModComparator->StructSizeMapR.lookup(
                                 IntR);
 
-                            if (SizeL != ModComparator->StructSizeMapL.end() &&
-                                SizeR != ModComparator->StructSizeMapR.end() &&
-                                SizeL->second == SizeR->second) {
+                            if (SizeL && SizeR && *SizeL == *SizeR) {
                                 DEBUG_WITH_TYPE(DEBUG_SIMPLL,
                                     dbgs() << "Comparing integers as equal "
                                            << "because of correspondence to "
@@ -536,7 +707,8 @@ std::vector<SyntaxDifference> DifferentialFunctionComparator::findAsmDifference(
         return {};
 
     // Create difference object.
-    // Note: the call stack is left empty here, it will be added in reportOutput
+    // Note: the call stack is left empty here, it will be added when the output
+    // report is created
     SyntaxDifference diff;
     diff.BodyL = AsmL;
     diff.BodyR = AsmR;
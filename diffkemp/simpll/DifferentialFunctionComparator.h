@@ -20,9 +20,41 @@
 #include "ModuleComparator.h"
 #include "Utils.h"
 #include "FunctionComparator.h"
+#include <llvm/IR/ValueHandle.h>
 
 using namespace llvm;
 
+/// State of a comparison of two non-equal functions that allows to resume the
+/// comparison after the functions are changed at the point where they differ
+/// (e.g. by inlining a call). Contains the prefix of basic blocks that were
+/// found equal (in the order in which the comparator walks them), serial
+/// numbers of the values seen in the prefix, and the blocks that remain to be
+/// compared. Instructions of the prefix are recorded so that the checkpoint is
+/// used only if the prefix did not change.
+struct ComparisonCheckpoint {
+    /// Recorded instruction of the prefix.
+    struct InstSnapshot {
+        WeakVH Inst;
+        std::vector<WeakVH> Operands;
+        unsigned OptionalData;
+        SmallVector<std::pair<unsigned, MDNode *>, 4> Metadata;
+    };
+    /// Recorded pair of equal basic blocks of the prefix.
+    struct BlockSnapshot {
+        WeakVH BlockL, BlockR;
+        std::vector<InstSnapshot> InstsL, InstsR;
+    };
+
+    bool Valid = false;
+    std::vector<BlockSnapshot> Prefix;
+    DenseMap<const Value *, int> SerialNumbersL, SerialNumbersR;
+    /// Stack of pairs of blocks to be compared (the top is the last one).
+    std::vector<std::pair<WeakVH, WeakVH>> Pending;
+
+    /// Check that the recorded prefix and the pending blocks did not change.
+    bool isUnchanged() const;
+};
+
 /// Extension of FunctionComparator from LLVM designed to compare functions in
 /// different modules (original FunctionComparator assumes that both functions
 /// are in a single module).
@@ -34,12 +66,19 @@ class DifferentialFunctionComparator : public FunctionComparator {
                                    bool controlFlowOnly,
                                    GlobalNumberState *GN,
                                    const DebugInfo *DI,
-                                   ModuleComparator *MC)
+                                   ModuleComparator *MC,
+                                   ComparisonCheckpoint *Checkpoint = nullptr)
             : FunctionComparator(F1, F2, GN), DI(DI),
               controlFlowOnly(controlFlowOnly),
               LayoutL(F1->getParent()->getDataLayout()),
               LayoutR(F2->getParent()->getDataLayout()),
-              ModComparator(MC) {}
+              ModComparator(MC), Checkpoint(Checkpoint) {}
+
+    /// Compare the functions. The comparison resumes from the checkpoint (if
+    /// it was given and the functions did not change before the point where
+    /// they differed). If the functions are not equal, the checkpoint is
+    /// updated.
+    int compare();
 
   protected:
     /// Specific comparison of GEP instructions/operators.
@@ -89,6 +128,20 @@ class DifferentialFunctionComparator : public FunctionComparator {
 
     ModuleComparator *ModComparator;
 
+    ComparisonCheckpoint *Checkpoint;
+    /// Set when serial numbers of values are erased in a way that breaks
+    /// their continuity (the checkpoint cannot be created then).
+    mutable bool ErasedSerialNumbers = false;
+
+    /// Record the equal basic blocks, serial numbers, and the blocks that
+    /// remain to be compared into the checkpoint.
+    void createCheckpoint(
+            const std::vector<std::pair<const BasicBlock *,
+                                        const BasicBlock *>> &Equal,
+            const SmallVectorImpl<const BasicBlock *> &PendingL,
+            const SmallVectorImpl<const BasicBlock *> &PendingR,
+            unsigned SerialNumbersL, unsigned SerialNumbersR);
+
     /// Looks for inline assembly differences between the certain values.
     /// Note: passing the parent function is necessary in order to properly
     /// generate the SyntaxDifference object.
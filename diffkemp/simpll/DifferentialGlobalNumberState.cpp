@@ -19,6 +19,9 @@
 /// Get number for a global value.
 /// Values with the same name are guaranteed to get the same number.
 uint64_t DifferentialGlobalNumberState::getNumber(GlobalValue *value) {
+    if (auto Fun = dyn_cast<Function>(value))
+        ModComparator->addUsedFunction(Fun);
+
     auto number = GlobalNumbers.find(value);
     u_int64_t result;
 
@@ -96,11 +99,11 @@ uint64_t DifferentialGlobalNumberState::getNumber(GlobalValue *value) {
             // the ModuleComparator.
             Function *OtherFun = otherModule->getFunction(Fun->getName());
 
-            auto FunPair = ModComparator->ComparedFuns.find({Fun, OtherFun});
-            if (OtherFun && FunPair == ModComparator->ComparedFuns.end()) {
-                // If the function was not compared yet, compare it.
-                ModComparator->compareFunctions(Fun, OtherFun);
-                FunPair = ModComparator->ComparedFuns.find({Fun, OtherFun});
+            if (OtherFun && ModComparator->ComparedFuns.find({Fun, OtherFun})
+                    == ModComparator->ComparedFuns.end()) {
+                // If the function was not compared yet, schedule its
+                // comparison. The comparison does not affect the number.
+                ModComparator->scheduleComparison(Fun, OtherFun);
             }
 
             // Search for a global number of the function since it might have
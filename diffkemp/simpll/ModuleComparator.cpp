@@ -16,19 +16,120 @@
 #include "DifferentialFunctionComparator.h"
 #include "Utils.h"
 #include "Config.h"
+#include "Stats.h"
+#include <llvm/ADT/SCCIterator.h>
+#include <llvm/Analysis/CallGraph.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Transforms/Utils/Cloning.h>
+#include <algorithm>
+
+/// Get the number of instructions of the function.
+static unsigned getInstructionCount(const Function *Fun) {
+    unsigned Count = 0;
+    for (auto &BB : *Fun)
+        Count += BB.size();
+    return Count;
+}
 
 /// Syntactical comparison of functions.
+/// Functions used by the compared functions are compared afterwards from
+/// a worklist instead of recursively, which would be too deep for long call
+/// chains.
+void ModuleComparator::compareFunctions(Function *FirstFun,
+                                        Function *SecondFun) {
+    compareFunctionPair(FirstFun, SecondFun);
+    runScheduledComparisons();
+}
+
+/// Schedule comparison of two functions. The comparison is run with the other
+/// scheduled comparisons in the bottom-up order of the call graph SCCs.
+/// Comparisons within a single SCC are run in the order in which they were
+/// scheduled, so the order does not depend on addresses of the functions.
+void ModuleComparator::scheduleComparison(Function *FirstFun,
+                                          Function *SecondFun) {
+    FunPair Funs(FirstFun, SecondFun);
+    if (Scheduled.find(Funs) != Scheduled.end())
+        return;
+    WorklistKey Key(getSCCIndex(FirstFun->getParent() == &First ? FirstFun
+                                                                : SecondFun),
+                    ScheduledCount++);
+    Scheduled.emplace(Funs, Key);
+    Worklist.emplace(Key, Funs);
+}
+
+/// Run the scheduled comparisons until there are none left. Comparisons may
+/// schedule further comparisons.
+/// The comparisons are run sequentially even if they belong to independent
+/// SCCs: a comparison may inline calls into the compared functions, hence it
+/// modifies both modules and the global numbering shared by all comparisons.
+void ModuleComparator::runScheduledComparisons() {
+    while (!Worklist.empty()) {
+        FunPair Funs = Worklist.begin()->second;
+        Worklist.erase(Worklist.begin());
+        Scheduled.erase(Funs);
+        if (ComparedFuns.find(Funs) == ComparedFuns.end())
+            compareFunctionPair(Funs.first, Funs.second);
+    }
+}
+
+/// Run the scheduled comparison of the function called by the call.
+/// Comparison of a function may change its body (by inlining), hence it must
+/// be done before the function is inlined into its caller.
+void ModuleComparator::compareScheduledCallee(const CallInst *Call) {
+    const Function *Callee = getCalledFunction(Call->getCalledValue());
+    if (!Callee)
+        return;
+    Function *FunFirst = First.getFunction(Callee->getName());
+    Function *FunSecond = Second.getFunction(Callee->getName());
+    for (FunPair Funs : {FunPair(FunFirst, FunSecond),
+                         FunPair(FunSecond, FunFirst)}) {
+        auto Sched = Scheduled.find(Funs);
+        if (Sched == Scheduled.end())
+            continue;
+        Worklist.erase(Sched->second);
+        Scheduled.erase(Sched);
+        // The comparison must not change the calls that the running
+        // comparison is going to inline.
+        auto RunningTryInline = tryInline;
+        compareFunctionPair(Funs.first, Funs.second);
+        tryInline = RunningTryInline;
+    }
+}
+
+/// Get index of the SCC of the call graph of the first module that contains
+/// the function. SCCs are indexed in the bottom-up order (callees first).
+/// The indices are computed once. Each function not found in the call graph
+/// (e.g. a function of the second module only) gets its own index following
+/// the indices of the SCCs when it is first seen.
+unsigned ModuleComparator::getSCCIndex(const Function *Fun) {
+    if (SCCIndices.empty()) {
+        CallGraph CG(First);
+        for (auto SCC = scc_begin(&CG); !SCC.isAtEnd(); ++SCC) {
+            for (auto *Node : *SCC) {
+                if (auto *NodeFun = Node->getFunction())
+                    SCCIndices[NodeFun] = NextSCCIndex;
+            }
+            ++NextSCCIndex;
+        }
+    }
+    auto Index = SCCIndices.find(Fun);
+    if (Index != SCCIndices.end())
+        return Index->second;
+    SCCIndices[Fun] = NextSCCIndex;
+    return NextSCCIndex++;
+}
+
+/// Syntactical comparison of a single pair of functions.
 /// Function declarations are equal if they have the same name.
 /// Functions with body are compared using custom FunctionComparator that
 /// is designed for comparing functions between different modules.
-void ModuleComparator::compareFunctions(Function *FirstFun,
-                                        Function *SecondFun) {
+void ModuleComparator::compareFunctionPair(Function *FirstFun,
+                                           Function *SecondFun) {
     DEBUG_WITH_TYPE(DEBUG_SIMPLL,
                     dbgs() << "Comparing " << FirstFun->getName() << " and "
                            << SecondFun->getName() << "\n");
     ComparedFuns.emplace(std::make_pair(FirstFun, SecondFun), Result::UNKNOWN);
+    countStat(Counter::FunctionsCompared);
 
     // Comparing function declarations (function without bodies).
     if (FirstFun->isDeclaration() || SecondFun->isDeclaration()) {
@@ -57,20 +158,93 @@ void ModuleComparator::compareFunctions(Function *FirstFun,
         return;
     }
 
+    // Try to use a result stored in the persistent cache.
+    std::string CacheKey;
+    unsigned DifferingObjectsCount = DifferingObjects.size();
+    if (Cache) {
+        CacheKey = Cache->getKey(FirstFun, SecondFun, *this);
+        ResultsCache::Entry Cached;
+        if (Cache->lookup(CacheKey, Cached)) {
+            DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                            dbgs() << "Using cached result for "
+                                   << FirstFun->getName() << "\n");
+            ComparedFuns.at({FirstFun, SecondFun}) =
+                    Cached.Equal ? Result::EQUAL : Result::NOT_EQUAL;
+            // Functions used during the comparison must be still compared
+            // (the same way as the comparison would do it). These are not
+            // recorded as used by the enclosing comparison.
+            UsedFunctions.emplace_back();
+            for (auto &Used : Cached.UsedFunctions) {
+                Module &Mod = Used.first == Program::First ? First : Second;
+                if (auto UsedFun = Mod.getFunction(Used.second))
+                    GS.getNumber(UsedFun);
+            }
+            UsedFunctions.pop_back();
+            return;
+        }
+        UsedFunctions.emplace_back();
+    }
+
     // Comparing functions with bodies using custom FunctionComparator.
+    // The checkpoint allows to resume the comparison after inlining.
+    tryInline = {nullptr, nullptr};
+    ComparisonCheckpoint Checkpoint;
+    ComparisonCheckpoint *ResumeFrom = ResumeAfterInlining ? &Checkpoint
+                                                           : nullptr;
     DifferentialFunctionComparator fComp(FirstFun, SecondFun, controlFlowOnly,
-                                         &GS, DI, this);
-    if (fComp.compare() == 0) {
+                                         &GS, DI, this, ResumeFrom);
+    int fCompResult = fComp.compare();
+
+    // Store the result into the persistent cache. Results that required
+    // inlining or that produced syntax differences are not stored since
+    // they depend on other functions.
+    if (Cache) {
+        ResultsCache::Entry Entry{fCompResult == 0, UsedFunctions.back()};
+        UsedFunctions.pop_back();
+        bool HasSyntaxDiff = std::any_of(
+                DifferingObjects.begin() + DifferingObjectsCount,
+                DifferingObjects.end(),
+                [FirstFun](const SyntaxDifference &Diff) {
+                    return Diff.function == FirstFun->getName();
+                });
+        if (Entry.Equal || (!tryInline.first && !tryInline.second &&
+                            !HasSyntaxDiff))
+            Cache->store(CacheKey, Entry);
+    }
+
+    if (fCompResult == 0) {
         DEBUG_WITH_TYPE(DEBUG_SIMPLL,
                         dbgs() << "Function " << FirstFun->getName()
                                << " is same in both modules\n");
         ComparedFuns.at({FirstFun, SecondFun}) = Result::EQUAL;
     } else {
         ComparedFuns.at({FirstFun, SecondFun}) = Result::NOT_EQUAL;
+        unsigned InliningRounds = 0;
+        unsigned InitialSize = getInstructionCount(FirstFun) +
+                               getInstructionCount(SecondFun);
         while (tryInline.first || tryInline.second) {
             // Try to inline the problematic function calls
             CallInst *inlineFirst = findCallInst(tryInline.first, FirstFun);
             CallInst *inlineSecond = findCallInst(tryInline.second, SecondFun);
+            if (inlineFirst)
+                compareScheduledCallee(inlineFirst);
+            if (inlineSecond)
+                compareScheduledCallee(inlineSecond);
+
+            unsigned Size = getInstructionCount(FirstFun) +
+                            getInstructionCount(SecondFun);
+            std::string BudgetExhausted = checkInliningBudget(
+                    inlineFirst, inlineSecond, InliningRounds,
+                    Size > InitialSize ? Size - InitialSize : 0);
+            if (!BudgetExhausted.empty()) {
+                DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                                dbgs() << "Inlining budget exhausted: "
+                                       << BudgetExhausted << "\n");
+                ComparedFuns.at({FirstFun, SecondFun}) = Result::UNKNOWN;
+                UnknownReasons[{FirstFun, SecondFun}] = BudgetExhausted;
+                tryInline = {nullptr, nullptr};
+                break;
+            }
 
             ConstFunPair missingDefs;
             bool inlined = false;
@@ -92,6 +266,8 @@ void ModuleComparator::compareFunctions(Function *FirstFun,
                                     == std::string::npos)
                         missingDefs.first = toInline;
                 } else {
+                    PhaseTimer InliningTimer(Phase::Inlining);
+                    countStat(Counter::InliningAttempts);
                     InlineFunctionInfo ifi;
                     if (InlineFunction(inlineFirst, ifi, nullptr, false)) {
                         simplifyFunction(FirstFun);
@@ -115,6 +291,8 @@ void ModuleComparator::compareFunctions(Function *FirstFun,
                                     == std::string::npos)
                         missingDefs.second = toInline;
                 } else {
+                    PhaseTimer InliningTimer(Phase::Inlining);
+                    countStat(Counter::InliningAttempts);
                     InlineFunctionInfo ifi;
                     if (InlineFunction(inlineSecond, ifi, nullptr, false)) {
                         simplifyFunction(FirstFun);
@@ -134,15 +312,73 @@ void ModuleComparator::compareFunctions(Function *FirstFun,
                 break;
             // Reset the function diff result
             ComparedFuns.at({FirstFun, SecondFun}) = Result::UNKNOWN;
-            // Re-run the comparison
+            InliningRounds++;
+            DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                            dbgs() << "Inlining round " << InliningRounds
+                                   << " of " << FirstFun->getName() << "\n");
+            // Re-run the comparison (from the point where the functions
+            // differed if the already compared part did not change)
             DifferentialFunctionComparator fCompSecond(FirstFun, SecondFun,
                                                        controlFlowOnly,
-                                                       &GS, DI, this);
+                                                       &GS, DI, this,
+                                                       ResumeFrom);
             if (fCompSecond.compare() == 0) {
                 ComparedFuns.at({FirstFun, SecondFun}) = Result::EQUAL;
             } else {
                 ComparedFuns.at({FirstFun, SecondFun}) = Result::NOT_EQUAL;
             }
         }
+        DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                        dbgs() << "Function " << FirstFun->getName()
+                               << " compared after " << InliningRounds
+                               << " inlining rounds\n");
+    }
+}
+
+/// Check if the calls can be inlined within the inlining budget. The cost of
+/// inlining a call is the number of instructions of the called function
+/// (calls of declarations are free since they are not inlined).
+/// \param Rounds Number of inlining rounds done so far.
+/// \param Growth Number of instructions added by inlining so far.
+/// \return Reason why the budget is exhausted or an empty string if the calls
+///         can be inlined.
+std::string ModuleComparator::checkInliningBudget(const CallInst *CallFirst,
+                                                  const CallInst *CallSecond,
+                                                  unsigned Rounds,
+                                                  unsigned Growth) const {
+    if (Budget.MaxRounds && Rounds >= Budget.MaxRounds)
+        return "reached the limit of " + std::to_string(Budget.MaxRounds) +
+               " inlining rounds";
+
+    unsigned Cost = 0;
+    for (const CallInst *Call : {CallFirst, CallSecond}) {
+        if (!Call)
+            continue;
+        const Function *Callee = getCalledFunction(Call->getCalledValue());
+        if (!Callee || Callee->isDeclaration())
+            continue;
+        unsigned Size = getInstructionCount(Callee);
+        if (Budget.MaxCalleeSize && Size > Budget.MaxCalleeSize)
+            return "function " + Callee->getName().str() + " has " +
+                   std::to_string(Size) + " instructions, which exceeds the "
+                   "limit of " + std::to_string(Budget.MaxCalleeSize) +
+                   " for inlining";
+        Cost += Size;
     }
+    if (Budget.MaxGrowth && Growth + Cost > Budget.MaxGrowth)
+        return "inlining would add more than " +
+               std::to_string(Budget.MaxGrowth) + " instructions";
+    return "";
+}
+
+/// Record that a function was used during the currently running comparison.
+void ModuleComparator::addUsedFunction(const Function *Fun) {
+    if (UsedFunctions.empty())
+        return;
+    ResultsCache::UsedFunction Used(
+            Fun->getParent() == &First ? Program::First : Program::Second,
+            Fun->getName());
+    auto &Current = UsedFunctions.back();
+    if (std::find(Current.begin(), Current.end(), Used) == Current.end())
+        Current.push_back(Used);
 }
@@ -15,11 +15,14 @@
 #ifndef DIFFKEMP_SIMPLL_MODULECOMPARATOR_H
 #define DIFFKEMP_SIMPLL_MODULECOMPARATOR_H
 
+#include "Config.h"
 #include "DebugInfo.h"
 #include "DifferentialGlobalNumberState.h"
+#include "ResultsCache.h"
 #include "SourceCodeUtils.h"
 #include "passes/StructureSizeAnalysis.h"
 #include "Utils.h"
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/Module.h>
 #include <set>
 
@@ -35,6 +38,9 @@ class ModuleComparator {
     enum Result { EQUAL, NOT_EQUAL, UNKNOWN };
     /// Storing results of function comparisons.
     std::map<FunPair, Result> ComparedFuns;
+    /// Reasons why comparisons of some functions did not finish (their
+    /// result is UNKNOWN).
+    std::map<FunPair, std::string> UnknownReasons;
     /// Storing results from macro and asm comparisions.
     std::vector<SyntaxDifference> DifferingObjects;
     // Function abstraction to assembly string map.
@@ -53,22 +59,79 @@ class ModuleComparator {
                      const DebugInfo *DI, StringMap<StringRef> &AsmToStringMapL,
                      StringMap<StringRef> &AsmToStringMapR,
                      StructureSizeAnalysis::Result &StructSizeMapL,
-                     StructureSizeAnalysis::Result &StructSizeMapR)
+                     StructureSizeAnalysis::Result &StructSizeMapR,
+                     ResultsCache *Cache = nullptr,
+                     const InliningBudget &Budget = InliningBudget(),
+                     bool ResumeAfterInlining = true)
             : First(First), Second(Second), controlFlowOnly(controlFlowOnly),
             GS(&First, &Second, this), DI(DI), AsmToStringMapL(AsmToStringMapL),
             AsmToStringMapR(AsmToStringMapR), StructSizeMapL(StructSizeMapL),
-            StructSizeMapR(StructSizeMapR) {}
+            StructSizeMapR(StructSizeMapR), Cache(Cache), Budget(Budget),
+            ResumeAfterInlining(ResumeAfterInlining) {}
 
-    /// Syntactically compare two functions.
+    /// Syntactically compare two functions and all functions that they use.
     /// The result of the comparison is stored into the ComparedFuns map.
     void compareFunctions(Function *FirstFun, Function *SecondFun);
 
+    /// Schedule comparison of two functions. Scheduled comparisons are run
+    /// after the currently running comparison is finished.
+    void scheduleComparison(Function *FirstFun, Function *SecondFun);
+
+    /// Record that a function was used during the currently running
+    /// comparison (needed to cache the result of the comparison).
+    void addUsedFunction(const Function *Fun);
+
     /// Pointer to a function that is called just by one of the compared
     /// functions and needs to be inlined.
     std::pair<const CallInst *, const CallInst*> tryInline = {nullptr, nullptr};
 
   private:
+    friend class ResultsCache;
+
     DifferentialGlobalNumberState GS;
+
+    /// Persistent cache of comparison results (NULL if not used).
+    ResultsCache *Cache;
+    /// Limits of inlining when comparing a pair of functions.
+    InliningBudget Budget;
+    /// Resume comparisons after inlining from the last checkpoint.
+    bool ResumeAfterInlining;
+    /// Functions used by the running comparisons (the innermost comparison
+    /// is the last one).
+    std::vector<std::vector<ResultsCache::UsedFunction>> UsedFunctions;
+
+    /// Position of a scheduled comparison in the worklist: the index of
+    /// the SCC of the compared functions and the sequence number of
+    /// the comparison (comparisons from the same SCC are run in the order in
+    /// which they were scheduled).
+    typedef std::pair<unsigned, unsigned> WorklistKey;
+    /// Scheduled comparisons ordered by the index of the SCC of the compared
+    /// functions, so that callees are compared before their callers.
+    std::map<WorklistKey, FunPair> Worklist;
+    /// Scheduled comparisons and their positions in the worklist.
+    std::map<FunPair, WorklistKey> Scheduled;
+    /// Number of comparisons scheduled so far.
+    unsigned ScheduledCount = 0;
+    /// Indices of SCCs of the call graph of the first module in the
+    /// bottom-up order.
+    DenseMap<const Function *, unsigned> SCCIndices;
+    /// Index to be given to the next function that is not in the call graph.
+    unsigned NextSCCIndex = 0;
+
+    /// Compare a single pair of functions. Comparisons of functions used by
+    /// the compared functions are only scheduled.
+    void compareFunctionPair(Function *FirstFun, Function *SecondFun);
+    /// Run the scheduled comparisons until there are none left.
+    void runScheduledComparisons();
+    /// Run the scheduled comparison of the function called by the call (if
+    /// there is such) so that the function is compared before it is inlined.
+    void compareScheduledCallee(const CallInst *Call);
+    /// Get index of the SCC of the call graph containing the function.
+    unsigned getSCCIndex(const Function *Fun);
+    /// Check if the calls can be inlined within the inlining budget.
+    std::string checkInliningBudget(const CallInst *CallFirst,
+                                    const CallInst *CallSecond,
+                                    unsigned Rounds, unsigned Growth) const;
 };
 
 #endif //DIFFKEMP_SIMPLL_MODULECOMPARATOR_H
@@ -14,6 +14,9 @@
 //===----------------------------------------------------------------------===//
 
 #include "Output.h"
+#include "Stats.h"
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/Support/YAMLTraits.h>
 
 using namespace llvm::yaml;
@@ -124,11 +127,66 @@ struct MappingTraits<MissingDefPair> {
 };
 }
 
+// Pair of functions whose comparison did not finish
+struct UnknownFunPair {
+    std::string first, second, reason;
+};
+
+// UnknownFunPair to YAML
+namespace llvm::yaml {
+template<>
+struct MappingTraits<UnknownFunPair> {
+    static void mapping(IO &io, UnknownFunPair &funs) {
+        io.mapRequired("first", funs.first);
+        io.mapRequired("second", funs.second);
+        io.mapRequired("reason", funs.reason);
+    }
+};
+}
+
+// Vector of UnknownFunPair to YAML
+LLVM_YAML_IS_SEQUENCE_VECTOR(UnknownFunPair);
+
+// PhaseStats to YAML
+namespace llvm::yaml {
+template<>
+struct MappingTraits<PhaseStats> {
+    static void mapping(IO &io, PhaseStats &phase) {
+        io.mapRequired("phase", phase.Name);
+        io.mapRequired("wall-time", phase.WallTime);
+        io.mapRequired("cpu-time", phase.CPUTime);
+    }
+};
+}
+
+// Vector of PhaseStats to YAML
+LLVM_YAML_IS_SEQUENCE_VECTOR(PhaseStats);
+
+// StatsReport to YAML (counters are mapped by their names)
+namespace llvm::yaml {
+template<>
+struct MappingTraits<StatsReport> {
+    static void mapping(IO &io, StatsReport &stats) {
+        io.mapRequired("phases", stats.Phases);
+        for (auto &Counter : stats.Counters)
+            io.mapRequired(Counter.Name.c_str(), Counter.Value);
+        io.mapRequired("peak-rss-kb", stats.PeakRSS);
+    }
+};
+}
+
 // Overall report: contains pairs of different (non-equal) functions
 struct ResultReport {
+    std::string function;
+    std::string variable;
     std::vector<DiffFunPair> diffFuns;
     std::vector<MissingDefPair> missingDefs;
     std::vector<SyndiffBody> syndiffBodies;
+    std::vector<UnknownFunPair> unknownFuns;
+    // Statistics of the whole run. In the batch mode and in the multi-variable
+    // mode, they are set in the first report (document) only and they cover
+    // the comparisons of all the reported functions or variables.
+    Optional<StatsReport> stats;
 };
 
 // Report to YAML
@@ -136,26 +194,48 @@ namespace llvm::yaml {
 template<>
 struct MappingTraits<ResultReport> {
     static void mapping(IO &io, ResultReport &result) {
+        if (!result.function.empty())
+            io.mapOptional("function", result.function);
+        if (!result.variable.empty())
+            io.mapOptional("variable", result.variable);
         io.mapOptional("diff-functions", result.diffFuns);
         io.mapOptional("missing-defs", result.missingDefs);
         io.mapOptional("syndiff-defs", result.syndiffBodies);
+        io.mapOptional("unknown-functions", result.unknownFuns);
+        if (result.stats.hasValue())
+            io.mapRequired("stats", result.stats.getValue());
     }
 };
 }
 
-void reportOutput(Config &config,
-                  std::vector<FunPair> &nonequalFuns,
-                  std::vector<ConstFunPair> &missingDefs,
-                  std::vector<SyntaxDifference> &differingSynDiffs) {
+// Vector of ResultReport to YAML (each report is a separate document)
+LLVM_YAML_IS_DOCUMENT_LIST_VECTOR(ResultReport);
+
+/// Create report of a single comparison result.
+static ResultReport makeReport(ComparisonResult &Result) {
+    auto &nonequalFuns = Result.nonequalFuns;
+    auto &missingDefs = Result.missingDefs;
+    auto &differingSynDiffs = Result.differingObjects;
+
     ResultReport report;
+    report.function = Result.Name;
+    report.variable = Result.Variable;
     // Set to store functions covered by syntax differences
     std::set<std::string> syntaxDiffCoveredFunctions;
 
-    // Transform non-equal functions into a function name set
-    std::set<StringRef> differingFunsSet;
+    // Index non-equal functions by their names
+    StringMap<Function *> differingFunsL, differingFunsR;
     for (FunPair FP : nonequalFuns) {
-        differingFunsSet.insert(FP.first->getName());
-        differingFunsSet.insert(FP.second->getName());
+        differingFunsL.insert({FP.first->getName(), FP.first});
+        differingFunsR.insert({FP.second->getName(), FP.second});
+    }
+
+    // Call stacks of all non-equal functions are taken from a single
+    // traversal of the call graph of each compared function
+    std::unique_ptr<CallStackTree> callStacksL, callStacksR;
+    if (!nonequalFuns.empty()) {
+        callStacksL.reset(new CallStackTree(*Result.FirstFun));
+        callStacksR.reset(new CallStackTree(*Result.SecondFun));
     }
 
     for (auto &synDiff : differingSynDiffs) {
@@ -176,8 +256,10 @@ void reportOutput(Config &config,
                 (ModuleR->getFunction(synDiff.function) == nullptr))
                 continue;
 
-            if (differingFunsSet.find(synDiff.function) ==
-                differingFunsSet.end()) {
+            if (differingFunsL.find(synDiff.function) ==
+                        differingFunsL.end() &&
+                differingFunsR.find(synDiff.function) ==
+                        differingFunsR.end()) {
                 skipSynDiff = true;
             }
         } else {
@@ -189,19 +271,12 @@ void reportOutput(Config &config,
 
         // Try to append call stack of function to the syndiff stack if possible
         CallStack toAppendLeft, toAppendRight;
-        for (auto &diff : nonequalFuns) {
-            // Find the right function diff
-            if (diff.first->getName() == synDiff.function) {
-                CallStack CS = getCallStack(*config.FirstFun, *diff.first);
-                if (!CS.empty())
-                    toAppendLeft = CS;
-            }
-            if (diff.second->getName() == synDiff.function) {
-                CallStack CS = getCallStack(*config.SecondFun, *diff.second);
-                if (!CS.empty())
-                    toAppendRight = CS;
-            }
-        }
+        auto diffL = differingFunsL.find(synDiff.function);
+        if (diffL != differingFunsL.end())
+            toAppendLeft = callStacksL->getCallStack(*diffL->second);
+        auto diffR = differingFunsR.find(synDiff.function);
+        if (diffR != differingFunsR.end())
+            toAppendRight = callStacksR->getCallStack(*diffR->second);
         if (toAppendLeft.size() > 0)
             synDiff.StackL.insert(synDiff.StackL.begin(),
                 toAppendLeft.begin(), toAppendLeft.end());
@@ -238,13 +313,13 @@ void reportOutput(Config &config,
         report.diffFuns.push_back({
                 FunctionInfo(funPair.first->getName(),
                              getFileForFun(funPair.first),
-                             getCallStack(*config.FirstFun, *funPair.first),
+                             callStacksL->getCallStack(*funPair.first),
                              false, funPair.first->getSubprogram() ?
                              funPair.first->getSubprogram()->getLine() : 0,
                              coveredBySyntaxDiff),
                 FunctionInfo(funPair.second->getName(),
                              getFileForFun(funPair.second),
-                             getCallStack(*config.SecondFun, *funPair.second),
+                             callStacksR->getCallStack(*funPair.second),
                              false, funPair.second->getSubprogram() ?
                              funPair.second->getSubprogram()->getLine() : 0,
                              coveredBySyntaxDiff)
@@ -255,7 +330,36 @@ void reportOutput(Config &config,
                 funPair.first ? funPair.first->getName() : "",
                 funPair.second ? funPair.second->getName() : "");
     }
+    for (auto &unknown : Result.unknownFuns) {
+        report.unknownFuns.push_back({unknown.first.first->getName(),
+                                      unknown.first.second->getName(),
+                                      unknown.second});
+    }
+
+    return report;
+}
+
+/// Create reports of all results.
+OutputReport::OutputReport(Config &config,
+                           std::vector<ComparisonResult> &Results)
+        : Batch(!config.FunctionList.empty()),
+          Reports(new std::vector<ResultReport>()) {
+    PhaseTimer OutputTimer(Phase::Output);
+    for (auto &Result : Results)
+        Reports->push_back(makeReport(Result));
+}
+
+OutputReport::~OutputReport() = default;
+
+/// Print the reports. Statistics are taken at the time of printing so that
+/// they include everything that was done after the report was created.
+void OutputReport::print() {
+    if (statsEnabled())
+        Reports->front().stats = getStats();
 
     llvm::yaml::Output output(outs());
-    output << report;
+    if (Batch)
+        output << *Reports;
+    else
+        output << Reports->front();
 }
@@ -18,13 +18,30 @@
 #include "Config.h"
 #include "Utils.h"
 #include "ModuleComparator.h"
+#include "Transforms.h"
 
-/// Report results in YAML format to stdout.
-/// \param config Configuration.
-/// \param nonequalFuns List of non-equal functions.
-void reportOutput(Config &config,
-                  std::vector<FunPair> &nonequalFuns,
-                  std::vector<ConstFunPair> &missingDefs,
-                  std::vector<SyntaxDifference> &differingMacros);
+struct ResultReport;
+
+/// Report of the results in YAML format.
+/// The report must be created before the compared modules are postprocessed
+/// (call stacks of the non-equal functions are taken from the modules) but it
+/// may be printed later, e.g. once the statistics of the whole run are known.
+class OutputReport {
+  public:
+    /// Create the report of the results of the comparison.
+    OutputReport(Config &config, std::vector<ComparisonResult> &Results);
+    ~OutputReport();
+
+    /// Print the report to stdout.
+    /// In the batch mode and in the multi-variable mode, one YAML document is
+    /// printed for each result. If statistics are collected, they are printed
+    /// in the first document only and they cover the whole run (the time and
+    /// the counters cannot be split between the individual results).
+    void print();
+
+  private:
+    bool Batch;
+    std::unique_ptr<std::vector<ResultReport>> Reports;
+};
 
 #endif // DIFFKEMP_SIMPLL_OUTPUT_H
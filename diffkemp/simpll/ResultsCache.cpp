@@ -0,0 +1,343 @@
+//===------------ ResultsCache.cpp - Cache of comparison results ----------===//
+//
+//       SimpLL - Program simplifier for analysis of semantic difference      //
+//
+// This file is published under Apache 2.0 license. See LICENSE for details.
+// Author: Viktor Malik, vmalik@redhat.com
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementation of the persistent (on-disk) cache of
+/// results of syntactic function comparison.
+///
+//===----------------------------------------------------------------------===//
+
+#include "ResultsCache.h"
+#include "Config.h"
+#include "ModuleComparator.h"
+#include "passes/FunctionAbstractionsGenerator.h"
+#include <llvm/ADT/SetVector.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/Debug.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/YAMLTraits.h>
+#include <llvm/Support/raw_ostream.h>
+#include <set>
+
+// Version of the format of the cache entries. Must be changed whenever
+// the computation of the keys or the meaning of the entries changes.
+static const char *CacheVersion = "simpll-cache-3";
+
+namespace llvm::yaml {
+// Program to YAML
+template<>
+struct ScalarEnumerationTraits<Program> {
+    static void enumeration(IO &io, Program &prog) {
+        io.enumCase(prog, "first", Program::First);
+        io.enumCase(prog, "second", Program::Second);
+    }
+};
+
+// Used function to YAML
+template<>
+struct MappingTraits<ResultsCache::UsedFunction> {
+    static void mapping(IO &io, ResultsCache::UsedFunction &fun) {
+        io.mapRequired("program", fun.first);
+        io.mapRequired("function", fun.second);
+    }
+};
+}
+
+// Vector of used functions to YAML
+LLVM_YAML_IS_SEQUENCE_VECTOR(ResultsCache::UsedFunction);
+
+// Entry to YAML
+namespace llvm::yaml {
+template<>
+struct MappingTraits<ResultsCache::Entry> {
+    static void mapping(IO &io, ResultsCache::Entry &entry) {
+        io.mapRequired("equal", entry.Equal);
+        io.mapOptional("used-functions", entry.UsedFunctions);
+    }
+};
+}
+
+/// Get the final value of the hash as a hexadecimal string.
+static std::string getHashString(MD5 &Hash) {
+    MD5::MD5Result Result;
+    Hash.final(Result);
+    SmallString<32> Str;
+    MD5::stringifyResult(Result, Str);
+    return Str.str();
+}
+
+/// Remove numbers of metadata nodes from the printed IR. These are specific
+/// for each module, hence they would prevent the same functions coming from
+/// different modules from having the same hash.
+static std::string stripMetadataNumbers(StringRef IR) {
+    std::string Result;
+    for (unsigned i = 0; i < IR.size(); i++) {
+        Result.push_back(IR[i]);
+        if (IR[i] == '!') {
+            while (i + 1 < IR.size() && isdigit(IR[i + 1]))
+                i++;
+        }
+    }
+    return Result;
+}
+
+/// Collect named structure types whose bodies are compared when comparing
+/// values of the given type. Pointers are not followed since types of pointers
+/// are compared without their element types.
+static void collectStructTypes(Type *Ty, SetVector<StructType *> &Structs) {
+    if (Ty->isPointerTy())
+        return;
+    if (auto STy = dyn_cast<StructType>(Ty)) {
+        if (STy->hasName() && !Structs.insert(STy))
+            return;
+    }
+    for (Type *Sub : Ty->subtypes())
+        collectStructTypes(Sub, Structs);
+}
+
+/// Collect global variables referenced by the value (possibly through
+/// constant expressions).
+static void collectGlobalVariables(const Value *Val,
+                                   SetVector<const GlobalVariable *> &Globals,
+                                   std::set<const Constant *> &Visited) {
+    if (auto Var = dyn_cast<GlobalVariable>(Val)) {
+        Globals.insert(Var);
+        return;
+    }
+    auto Const = dyn_cast<Constant>(Val);
+    if (!Const || isa<GlobalValue>(Const) || !Visited.insert(Const).second)
+        return;
+    for (auto &Op : Const->operands())
+        collectGlobalVariables(Op.get(), Globals, Visited);
+}
+
+/// Compute the key of the comparison of the given functions. The key is a hash
+/// of both functions and of the options of the comparison.
+std::string ResultsCache::getKey(const Function *FunFirst,
+                                 const Function *FunSecond,
+                                 const ModuleComparator &ModComp) {
+    MD5 Hash;
+    Hash.update(CacheVersion);
+    Hash.update(ModComp.controlFlowOnly ? "control-flow;" : ";");
+    hashFunction(Hash, FunFirst, Program::First, ModComp);
+    hashFunction(Hash, FunSecond, Program::Second, ModComp);
+    return getHashString(Hash);
+}
+
+/// Add a hash of the function into the computed hash.
+/// Besides the instructions themselves (including their operands and types),
+/// everything that the comparison of the function uses is hashed:
+///  - signature and attributes of the function,
+///  - bodies of the named structure types used by the function (the names of
+///    the types are not sufficient since the types are compared by their
+///    bodies),
+///  - initializers of the referenced global variables (some constant global
+///    variables are compared by their values rather than by their names),
+///  - debug locations of instructions together with the contents of the
+///    corresponding source files,
+///  - names of the accessed struct fields,
+///  - values of macros that the constants in the function may come from,
+///  - sizes of structures, and
+///  - inline assemblies of the abstractions called by the function.
+void ResultsCache::hashFunction(MD5 &Hash, const Function *Fun, Program Prog,
+                                const ModuleComparator &ModComp) {
+    auto &SlotTracker = SlotTrackers[Fun->getParent()];
+    if (!SlotTracker)
+        SlotTracker = std::unique_ptr<ModuleSlotTracker>(
+                new ModuleSlotTracker(Fun->getParent(), false));
+    SlotTracker->incorporateFunction(*Fun);
+
+    auto &StructSizeMap = Prog == Program::First ? ModComp.StructSizeMapL
+                                                 : ModComp.StructSizeMapR;
+    auto &AsmToStringMap = Prog == Program::First ? ModComp.AsmToStringMapL
+                                                  : ModComp.AsmToStringMapR;
+
+    std::string Str;
+    raw_string_ostream OS(Str);
+    // Signature
+    OS << Fun->getParent()->getDataLayoutStr() << "\n";
+    Fun->getFunctionType()->print(OS);
+    OS << " cc" << Fun->getCallingConv() << " " << Fun->getSection();
+    if (Fun->hasGC())
+        OS << " gc " << Fun->getGC();
+    auto Attrs = Fun->getAttributes();
+    for (unsigned i = Attrs.index_begin(); i != Attrs.index_end(); ++i)
+        OS << " " << Attrs.getAsString(i);
+    OS << "\n";
+
+    SetVector<StructType *> Structs;
+    SetVector<const GlobalVariable *> Globals;
+    std::set<const Constant *> VisitedConstants;
+    collectStructTypes(Fun->getFunctionType(), Structs);
+    for (auto &BB : *Fun) {
+        OS << "bb\n";
+        for (auto &Inst : BB) {
+            std::string InstStr;
+            raw_string_ostream InstOS(InstStr);
+            Inst.print(InstOS, *SlotTracker);
+            OS << stripMetadataNumbers(InstOS.str()) << "\n";
+
+            collectStructTypes(Inst.getType(), Structs);
+            if (auto Alloca = dyn_cast<AllocaInst>(&Inst))
+                collectStructTypes(Alloca->getAllocatedType(), Structs);
+            if (auto GEP = dyn_cast<GetElementPtrInst>(&Inst))
+                collectStructTypes(GEP->getSourceElementType(), Structs);
+
+            if (DILocation *Loc = Inst.getDebugLoc().get()) {
+                OS << " loc " << Loc->getFilename() << ":" << Loc->getLine()
+                   << ":" << Loc->getColumn() << " "
+                   << getSourceHash(getSourceFilePath(Loc->getScope()))
+                   << "\n";
+            }
+
+            if (auto GEP = dyn_cast<GetElementPtrInst>(&Inst)) {
+                std::vector<Value *> Indices;
+                for (auto Idx = GEP->idx_begin(); Idx != GEP->idx_end();
+                     ++Idx) {
+                    auto IndexedType = GetElementPtrInst::getIndexedType(
+                            GEP->getSourceElementType(), Indices);
+                    Indices.push_back(*Idx);
+                    auto IndexConst = dyn_cast<ConstantInt>(*Idx);
+                    auto IndexedStruct = dyn_cast_or_null<StructType>(
+                            IndexedType);
+                    if (!IndexConst || !IndexedStruct || !ModComp.DI)
+                        continue;
+                    auto FieldName = ModComp.DI->getFieldName(
+                            IndexedStruct, IndexConst->getZExtValue(), Prog);
+                    if (!FieldName.empty())
+                        OS << " field " << Indices.size() << " "
+                           << FieldName << "\n";
+                }
+            }
+
+            for (auto &Op : Inst.operands()) {
+                collectStructTypes(Op->getType(), Structs);
+                collectGlobalVariables(Op.get(), Globals, VisitedConstants);
+                if (auto Const = dyn_cast<ConstantInt>(Op)) {
+                    auto Size = StructSizeMap.lookup(Const->getZExtValue());
+                    if (Size) {
+                        OS << " size " << Const->getZExtValue();
+                        for (auto &Name : *Size)
+                            OS << " " << Name;
+                        OS << "\n";
+                    }
+                }
+                if (auto Const = dyn_cast<Constant>(Op)) {
+                    if (Prog == Program::First && ModComp.DI) {
+                        auto Macro = ModComp.DI->MacroConstantMap.find(Const);
+                        if (Macro != ModComp.DI->MacroConstantMap.end())
+                            OS << " macro " << Macro->second << "\n";
+                    }
+                }
+                if (auto Called = dyn_cast<Function>(Op)) {
+                    if (Called->getName().startswith(SimpllInlineAsmPrefix))
+                        OS << " asm " << AsmToStringMap.lookup(
+                                Called->getName()) << "\n";
+                }
+            }
+        }
+    }
+
+    // Types of the initializers are collected too, hence the structure types
+    // are hashed after the global variables.
+    for (auto *Var : Globals) {
+        OS << "global " << Var->getName()
+           << (Var->hasGlobalUnnamedAddr() ? " unnamed_addr" : "")
+           << (Var->isConstant() ? " constant" : "");
+        if (Var->hasInitializer()) {
+            std::string InitStr;
+            raw_string_ostream InitOS(InitStr);
+            Var->getInitializer()->print(InitOS, *SlotTracker);
+            OS << " " << stripMetadataNumbers(InitOS.str());
+            collectStructTypes(Var->getValueType(), Structs);
+        }
+        OS << "\n";
+    }
+    for (StructType *STy : Structs) {
+        OS << "struct " << STy->getName();
+        if (STy->isOpaque()) {
+            OS << " opaque\n";
+            continue;
+        }
+        OS << (STy->isPacked() ? " packed" : "");
+        for (Type *Elem : STy->elements()) {
+            OS << " ";
+            Elem->print(OS);
+        }
+        OS << "\n";
+    }
+    Hash.update(OS.str());
+}
+
+/// Get hash of the contents of a source file. The hashes are computed only
+/// once for each file.
+StringRef ResultsCache::getSourceHash(const std::string &File) {
+    auto Cached = SourceHashes.find(File);
+    if (Cached != SourceHashes.end())
+        return Cached->second;
+
+    std::string Result;
+    auto Buffer = MemoryBuffer::getFile(File);
+    if (Buffer) {
+        MD5 Hash;
+        Hash.update((*Buffer)->getBuffer());
+        Result = getHashString(Hash);
+    }
+    return SourceHashes.insert({File, Result}).first->second;
+}
+
+/// Get path to the file containing the entry with the given key. Entries are
+/// split into subdirectories by the first two characters of the key so that
+/// directories do not grow too large.
+std::string ResultsCache::getEntryFile(const std::string &Key) const {
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, Key.substr(0, 2), Key.substr(2) + ".yaml");
+    return Path.str();
+}
+
+/// Find a cached result.
+bool ResultsCache::lookup(const std::string &Key, Entry &Result) const {
+    auto Buffer = MemoryBuffer::getFile(getEntryFile(Key));
+    if (!Buffer)
+        return false;
+
+    llvm::yaml::Input input((*Buffer)->getBuffer());
+    input >> Result;
+    if (input.error()) {
+        DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                        dbgs() << "Invalid cache entry " << Key << "\n");
+        return false;
+    }
+    return true;
+}
+
+/// Store a result into the cache. The entry is written into a temporary file
+/// first and then it is renamed so that concurrently running SimpLL processes
+/// never read an incomplete entry.
+void ResultsCache::store(const std::string &Key, const Entry &Result) const {
+    std::string File = getEntryFile(Key);
+    StringRef EntryDir = sys::path::parent_path(File);
+    if (sys::fs::create_directories(EntryDir))
+        return;
+
+    int FD;
+    SmallString<128> TmpFile;
+    if (sys::fs::createUniqueFile(EntryDir + "/%%%%%%%%.tmp", FD, TmpFile))
+        return;
+    {
+        raw_fd_ostream Stream(FD, true);
+        llvm::yaml::Output output(Stream);
+        Entry ToWrite = Result;
+        output << ToWrite;
+    }
+    if (sys::fs::rename(TmpFile, File))
+        sys::fs::remove(TmpFile);
+}
@@ -0,0 +1,79 @@
+//===------------- ResultsCache.h - Cache of comparison results -----------===//
+//
+//       SimpLL - Program simplifier for analysis of semantic difference      //
+//
+// This file is published under Apache 2.0 license. See LICENSE for details.
+// Author: Viktor Malik, vmalik@redhat.com
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the declaration of the persistent (on-disk) cache of
+/// results of syntactic function comparison.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef DIFFKEMP_SIMPLL_RESULTSCACHE_H
+#define DIFFKEMP_SIMPLL_RESULTSCACHE_H
+
+#include "Utils.h"
+#include <llvm/ADT/StringMap.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ModuleSlotTracker.h>
+#include <llvm/Support/MD5.h>
+#include <map>
+
+using namespace llvm;
+
+class ModuleComparator;
+
+/// Cache of results of function comparison that is persistent across SimpLL
+/// runs. The cache is content-addressed - the key of each entry is a hash of
+/// the compared functions (including everything that the comparison of the
+/// functions depends on) and of the used options.
+/// Only results that do not depend on bodies of other functions (i.e. no
+/// inlining was necessary) are stored.
+class ResultsCache {
+  public:
+    /// Function used during a comparison (given by its name and by the
+    /// program it belongs to).
+    typedef std::pair<Program, std::string> UsedFunction;
+
+    /// Cached result of a comparison.
+    struct Entry {
+        /// True if the functions are syntactically equal.
+        bool Equal;
+        /// Functions that were used during the comparison. Their comparison
+        /// must be run whenever the entry is used.
+        std::vector<UsedFunction> UsedFunctions;
+    };
+
+    ResultsCache(const std::string &Dir) : Dir(Dir) {}
+
+    /// Compute the key of the comparison of the given functions.
+    std::string getKey(const Function *FunFirst, const Function *FunSecond,
+                       const ModuleComparator &ModComp);
+
+    /// Find a cached result.
+    /// \return True if the entry was found.
+    bool lookup(const std::string &Key, Entry &Result) const;
+
+    /// Store a result into the cache.
+    void store(const std::string &Key, const Entry &Result) const;
+
+  private:
+    std::string Dir;
+    /// Hashes of the contents of source files (indexed by the file path).
+    StringMap<std::string> SourceHashes;
+    /// Slot trackers used to print instructions of each module.
+    std::map<const Module *, std::unique_ptr<ModuleSlotTracker>> SlotTrackers;
+
+    /// Add a hash of the function into the computed hash.
+    void hashFunction(MD5 &Hash, const Function *Fun, Program Prog,
+                      const ModuleComparator &ModComp);
+    /// Get hash of the contents of a source file.
+    StringRef getSourceHash(const std::string &File);
+    /// Get path to the file containing the entry with the given key.
+    std::string getEntryFile(const std::string &Key) const;
+};
+
+#endif // DIFFKEMP_SIMPLL_RESULTSCACHE_H
@@ -0,0 +1,289 @@
+//===------------------ Server.cpp - SimpLL server mode -------------------===//
+//
+//       SimpLL - Program simplifier for analysis of semantic difference      //
+//
+// This file is published under Apache 2.0 license. See LICENSE for details.
+// Author: Viktor Malik, vmalik@redhat.com
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementation of the SimpLL server and of the
+/// cache of parsed modules that the server uses.
+///
+//===----------------------------------------------------------------------===//
+
+#include "Server.h"
+#include "Config.h"
+#include "Stats.h"
+#include "Transforms.h"
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/GlobalAlias.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Support/Debug.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/YAMLTraits.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+#include <iostream>
+#include <set>
+
+/// Get the module stored in the given file. The file is parsed only if it is
+/// not cached yet or if it has changed since it was parsed.
+const Module *ModuleCache::getModule(Program Prog, const std::string &File,
+                                     SMDiagnostic &Err) {
+    ModuleKey Key(Prog, File);
+    sys::fs::file_status Status;
+    bool HasStatus = !sys::fs::status(File, Status);
+
+    auto Cached = Modules.find(Key);
+    if (Cached != Modules.end()) {
+        if (HasStatus &&
+                Cached->second.ModificationTime ==
+                        Status.getLastModificationTime() &&
+                Cached->second.Size == Status.getSize()) {
+            markUsed(Key);
+            return Cached->second.Mod.get();
+        }
+        // The file has changed since it was parsed
+        UsageOrder.remove(Key);
+        Modules.erase(Cached);
+    }
+
+    // Evict the least recently used modules to make space for the new one
+    while (Modules.size() >= MaxSize) {
+        Modules.erase(UsageOrder.back());
+        UsageOrder.pop_back();
+    }
+
+    CachedModule New;
+    New.Context = std::unique_ptr<LLVMContext>(new LLVMContext());
+    New.Mod = parseIRFile(File, Err, *New.Context);
+    if (!New.Mod)
+        return nullptr;
+    if (HasStatus) {
+        New.ModificationTime = Status.getLastModificationTime();
+        New.Size = Status.getSize();
+    }
+    DEBUG_WITH_TYPE(DEBUG_SIMPLL, dbgs() << "Parsed " << File << "\n");
+
+    const Module *Result = New.Mod.get();
+    Modules.emplace(Key, std::move(New));
+    UsageOrder.push_front(Key);
+    return Result;
+}
+
+/// Mark the module as the most recently used one.
+void ModuleCache::markUsed(const ModuleKey &Key) {
+    UsageOrder.remove(Key);
+    UsageOrder.push_front(Key);
+}
+
+/// Single comparison request.
+struct ServerRequest {
+    std::string FirstFile;
+    std::string SecondFile;
+    std::string Fun;
+    std::string Var;
+    std::string Suffix;
+    bool ControlFlowOnly;
+    bool PrintCallStacks;
+    std::string FirstLinkIndex;
+    std::string SecondLinkIndex;
+    bool VerdictOnly;
+    bool Parallel;
+    bool DropUnreachable;
+    bool DropDebugInfo;
+    unsigned MaxInliningRounds;
+    unsigned MaxInliningGrowth;
+    unsigned MaxInlinedSize;
+};
+
+/// Error that occurred when processing a request.
+struct ServerError {
+    std::string Message;
+};
+
+namespace llvm::yaml {
+// ServerRequest from YAML
+template<>
+struct MappingTraits<ServerRequest> {
+    static void mapping(IO &io, ServerRequest &request) {
+        io.mapRequired("first", request.FirstFile);
+        io.mapRequired("second", request.SecondFile);
+        io.mapOptional("fun", request.Fun);
+        io.mapOptional("var", request.Var);
+        io.mapOptional("suffix", request.Suffix);
+        io.mapOptional("control-flow", request.ControlFlowOnly, false);
+        io.mapOptional("print-callstacks", request.PrintCallStacks, true);
+        io.mapOptional("first-link-index", request.FirstLinkIndex);
+        io.mapOptional("second-link-index", request.SecondLinkIndex);
+        io.mapOptional("verdict-only", request.VerdictOnly, false);
+        io.mapOptional("parallel", request.Parallel, false);
+        io.mapOptional("drop-unreachable", request.DropUnreachable, false);
+        io.mapOptional("drop-unreachable-debug-info", request.DropDebugInfo,
+                       false);
+        io.mapOptional("max-inlining-rounds", request.MaxInliningRounds, 0u);
+        io.mapOptional("max-inlining-growth", request.MaxInliningGrowth, 0u);
+        io.mapOptional("max-inlined-size", request.MaxInlinedSize, 0u);
+    }
+};
+
+// ServerError to YAML
+template<>
+struct MappingTraits<ServerError> {
+    static void mapping(IO &io, ServerError &error) {
+        io.mapRequired("error", error.Message);
+    }
+};
+}
+
+/// Report an error that occurred when processing a request.
+static void reportError(const std::string &Message) {
+    DEBUG_WITH_TYPE(DEBUG_SIMPLL, dbgs() << "Error: " << Message << "\n");
+    ServerError Error{Message};
+    llvm::yaml::Output output(outs());
+    output << Error;
+}
+
+/// Find names of all functions that may be needed for comparing the given
+/// functions. These are all functions that are transitively referenced from
+/// the compared functions in any of the two modules (functions having the
+/// same name are compared with each other, hence a function needed in one of
+/// the modules must be kept in both of them).
+static std::set<std::string> getNeededFunctions(
+        const Module &First, const Module &Second,
+        const std::vector<std::string> &Roots) {
+    std::set<std::string> Needed;
+    std::set<const Constant *> Visited;
+    std::vector<std::string> Worklist = Roots;
+    while (!Worklist.empty()) {
+        std::string Name = Worklist.back();
+        Worklist.pop_back();
+        if (!Needed.insert(Name).second)
+            continue;
+
+        for (const Module *Mod : {&First, &Second}) {
+            const Function *Fun = Mod->getFunction(Name);
+            if (!Fun)
+                continue;
+            std::vector<const Function *> Referenced;
+            for (auto &BB : *Fun)
+                for (auto &Inst : BB)
+                    for (auto &Op : Inst.operands())
+                        collectReferencedFunctions(Op.get(), Visited,
+                                                   Referenced);
+            for (auto *RefFun : Referenced)
+                Worklist.push_back(RefFun->getName());
+        }
+    }
+    return Needed;
+}
+
+/// Create a copy of the module in which only the needed functions have
+/// bodies. All other functions are turned into declarations.
+static std::unique_ptr<Module> copyModule(
+        const Module &Mod, const std::set<std::string> &Needed) {
+    ValueToValueMapTy VMap;
+    return CloneModule(&Mod, VMap, [&Needed](const GlobalValue *GV) {
+        // An alias to a function can be kept only if the function is kept.
+        if (auto Alias = dyn_cast<GlobalAlias>(GV))
+            GV = Alias->getBaseObject();
+        if (auto Fun = dyn_cast_or_null<Function>(GV))
+            return Needed.find(Fun->getName()) != Needed.end();
+        return true;
+    });
+}
+
+/// Process a single request: prepare copies of the requested modules, run the
+/// simplification, and report the result. Statistics are collected for each
+/// request separately, the parsing phase includes copying of the modules.
+static void processRequest(ModuleCache &Cache, const ServerRequest &Request) {
+    resetStats();
+    PhaseTimer ParsingTimer(Phase::Parsing);
+    SMDiagnostic Err;
+    const Module *First = Cache.getModule(Program::First, Request.FirstFile,
+                                          Err);
+    if (!First) {
+        reportError("Cannot parse " + Request.FirstFile);
+        return;
+    }
+    const Module *Second = Cache.getModule(Program::Second,
+                                           Request.SecondFile, Err);
+    if (!Second) {
+        reportError("Cannot parse " + Request.SecondFile);
+        return;
+    }
+
+    std::unique_ptr<Module> FirstCopy, SecondCopy;
+    if (Request.Fun.empty()) {
+        // All functions are compared, the modules must be copied completely.
+        FirstCopy = CloneModule(First);
+        SecondCopy = CloneModule(Second);
+    } else {
+        auto FunNames = StringRef(Request.Fun).split(',');
+        std::vector<std::string> Roots = {FunNames.first};
+        if (!FunNames.second.empty())
+            Roots.push_back(FunNames.second);
+
+        auto Needed = getNeededFunctions(*First, *Second, Roots);
+        DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                        dbgs() << "Copying " << Needed.size()
+                               << " functions\n");
+        FirstCopy = copyModule(*First, Needed);
+        SecondCopy = copyModule(*Second, Needed);
+    }
+
+    Config config(std::move(FirstCopy), std::move(SecondCopy),
+                  Request.FirstFile, Request.SecondFile,
+                  Request.Fun, Request.Var, Request.Suffix,
+                  Request.ControlFlowOnly, Request.PrintCallStacks);
+    if (!Request.FirstLinkIndex.empty())
+        config.FirstLinkIndex = Request.FirstLinkIndex;
+    if (!Request.SecondLinkIndex.empty())
+        config.SecondLinkIndex = Request.SecondLinkIndex;
+    if (Request.VerdictOnly)
+        config.VerdictOnly = true;
+    if (Request.Parallel)
+        config.Parallel = true;
+    if (Request.DropUnreachable)
+        config.DropUnreachable = true;
+    if (Request.DropDebugInfo)
+        config.DropDebugInfo = true;
+    if (Request.MaxInliningRounds)
+        config.Inlining.MaxRounds = Request.MaxInliningRounds;
+    if (Request.MaxInliningGrowth)
+        config.Inlining.MaxGrowth = Request.MaxInliningGrowth;
+    if (Request.MaxInlinedSize)
+        config.Inlining.MaxCalleeSize = Request.MaxInlinedSize;
+    if (!Request.Fun.empty() && (!config.FirstFun || !config.SecondFun)) {
+        reportError("Function " + Request.Fun + " not found");
+        return;
+    }
+    ParsingTimer.stop();
+
+    runSimplification(config);
+}
+
+/// Run SimpLL as a server reading requests from stdin.
+int runServer() {
+    ModuleCache Cache(ServerCacheSizeOpt);
+
+    std::string Line;
+    while (std::getline(std::cin, Line)) {
+        if (StringRef(Line).trim().empty())
+            continue;
+
+        ServerRequest Request;
+        llvm::yaml::Input input(Line);
+        input >> Request;
+        if (input.error())
+            reportError("Invalid request: " + Line);
+        else
+            processRequest(Cache, Request);
+
+        // The client waits for the whole response, it must not stay buffered.
+        outs().flush();
+    }
+    return 0;
+}
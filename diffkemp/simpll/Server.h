@@ -0,0 +1,77 @@
+//===------------------- Server.h - SimpLL server mode --------------------===//
+//
+//       SimpLL - Program simplifier for analysis of semantic difference      //
+//
+// This file is published under Apache 2.0 license. See LICENSE for details.
+// Author: Viktor Malik, vmalik@redhat.com
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the declaration of the SimpLL server that keeps parsed
+/// modules in memory and processes comparison requests read from stdin.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef DIFFKEMP_SIMPLL_SERVER_H
+#define DIFFKEMP_SIMPLL_SERVER_H
+
+#include "Utils.h"
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/SourceMgr.h>
+#include <list>
+#include <map>
+
+using namespace llvm;
+
+/// Cache of parsed LLVM modules.
+/// Each module is parsed only once and it is kept in memory until the file
+/// containing it changes or until the module is evicted from the cache (the
+/// least recently used module is evicted when the cache is full).
+/// Cached modules must not be modified, copies of them should be used instead.
+class ModuleCache {
+  public:
+    ModuleCache(unsigned MaxSize) : MaxSize(std::max(MaxSize, 2u)) {}
+
+    /// Get the module stored in the given file.
+    /// Modules of each program are stored separately so that modules of the
+    /// compared programs never share the same context.
+    /// \return Parsed module or nullptr if the file could not be parsed.
+    const Module *getModule(Program Prog, const std::string &File,
+                            SMDiagnostic &Err);
+
+  private:
+    struct CachedModule {
+        std::unique_ptr<LLVMContext> Context;
+        std::unique_ptr<Module> Mod;
+        sys::TimePoint<> ModificationTime;
+        uint64_t Size;
+    };
+    typedef std::pair<Program, std::string> ModuleKey;
+
+    unsigned MaxSize;
+    std::map<ModuleKey, CachedModule> Modules;
+    /// Keys of the cached modules, the most recently used one is the first.
+    std::list<ModuleKey> UsageOrder;
+
+    /// Mark the module as the most recently used one.
+    void markUsed(const ModuleKey &Key);
+};
+
+/// Run SimpLL as a server.
+/// The server reads comparison requests from stdin, one request per line.
+/// Each request is a YAML (or JSON) mapping with the same options as the
+/// command line interface has:
+///   {first: <file>, second: <file>, fun: <fun>, var: <var>,
+///    suffix: <suffix>, control-flow: <bool>, print-callstacks: <bool>,
+///    first-link-index: <file>, second-link-index: <file>,
+///    verdict-only: <bool>}
+/// For each request, the same YAML report as in the normal mode is printed to
+/// stdout (terminated by the YAML document end marker) and the simplified
+/// modules are written to the output files (unless verdict-only is set and
+/// all functions are equal).
+/// \return Exit code of the program.
+int runServer();
+
+#endif // DIFFKEMP_SIMPLL_SERVER_H
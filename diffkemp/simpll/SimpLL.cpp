@@ -12,63 +12,61 @@
 //===----------------------------------------------------------------------===//
 
 #include "Config.h"
+#include "Server.h"
+#include "Stats.h"
+#include "SymbolIndex.h"
 #include "Transforms.h"
-#include "Utils.h"
-#include "Output.h"
-#include "ModuleComparator.h"
-#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Debug.h>
+#include <llvm/Support/ManagedStatic.h>
 #include <llvm/Support/raw_ostream.h>
 
 using namespace llvm;
 
-/// Write LLVM IR of a module into a file.
-/// \param Mod LLVM module to write.
-/// \param FileName Path to the file to write to.
-void writeIRToFile(Module &Mod, StringRef FileName) {
-    std::error_code errorCode;
-    raw_fd_ostream stream(FileName, errorCode, sys::fs::F_None);
-    Mod.print(stream, nullptr);
-    stream.close();
-}
-
 int main(int argc, const char **argv) {
     // Parse CLI options
     cl::ParseCommandLineOptions(argc, argv);
-    Config config;
-
-    // Run transformations
-    preprocessModule(*config.First, config.FirstFun, config.FirstVar,
-                     config.ControlFlowOnly);
-    preprocessModule(*config.Second, config.SecondFun, config.SecondVar,
-                     config.ControlFlowOnly);
-    config.refreshFunctions();
-
-    std::vector<FunPair> nonequalFuns;
-    std::vector<ConstFunPair> missingDefs;
-    std::vector<SyntaxDifference> differingMacros;
-    simplifyModulesDiff(config, nonequalFuns, missingDefs, differingMacros);
-
-    reportOutput(config, nonequalFuns, missingDefs, differingMacros);
-
-    // Split list of non-equal function pairs into two sets.
-    std::set<Function *> MainFunsFirst;
-    std::transform(nonequalFuns.begin(),
-                   nonequalFuns.end(),
-                   std::inserter(MainFunsFirst, MainFunsFirst.begin()),
-                   [](FunPair &p) { return p.first; });
-    std::set<Function *> MainFunsSecond;
-    std::transform(nonequalFuns.begin(),
-                   nonequalFuns.end(),
-                   std::inserter(MainFunsSecond, MainFunsSecond.begin()),
-                   [](FunPair &p) { return p.second; });
-
-    postprocessModule(*config.First, MainFunsFirst);
-    postprocessModule(*config.Second, MainFunsSecond);
+    if (VerboseOpt) {
+        // Enable debugging output in passes
+        DebugFlag = true;
+        setCurrentDebugType(DEBUG_SIMPLL);
+    }
+    if (StatsOpt)
+        enableStats();
 
-    // Write LLVM IR to output files
-    writeIRToFile(*config.First, config.FirstOutFile);
-    writeIRToFile(*config.Second, config.SecondOutFile);
+    int exitCode = 0;
+    if (ServerOpt) {
+        exitCode = runServer();
+    } else if (!SymbolIndexOpt.empty()) {
+        exitCode = writeSymbolIndex(SymbolIndexOpt);
+    } else {
+        if (FirstFileOpt.empty() || SecondFileOpt.empty()) {
+            errs() << "Two input files must be specified\n";
+            return 1;
+        }
+        if (!FunctionListOpt.empty() &&
+                (!FunctionOpt.empty() || !VariableOpt.empty())) {
+            errs() << "--fun-list cannot be combined with --fun or --var\n";
+            return 1;
+        }
+        if (!VariableListOpt.empty() &&
+                (FunctionOpt.empty() || !FunctionListOpt.empty() ||
+                 !VariableOpt.empty())) {
+            errs() << "--var-list requires --fun and cannot be combined "
+                      "with --fun-list or --var\n";
+            return 1;
+        }
+        PhaseTimer ParsingTimer(Phase::Parsing);
+        Config config;
+        ParsingTimer.stop();
+        // Report a missing function the same way as the server does rather
+        // than comparing nothing (which would look like a success).
+        if (!FunctionOpt.empty() && (!config.FirstFun || !config.SecondFun)) {
+            errs() << "Function " << FunctionOpt << " not found\n";
+            return 1;
+        }
+        runSimplification(config);
+    }
 
     llvm_shutdown();
-    return 0;
+    return exitCode;
 }
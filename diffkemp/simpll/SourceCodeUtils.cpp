@@ -14,14 +14,19 @@
 
 #include "SourceCodeUtils.h"
 #include "Config.h"
+#include "Stats.h"
 #include "Utils.h"
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/Support/Debug.h>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Support/LineIterator.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/raw_ostream.h>
+#include <mutex>
 
 /// Gets all macros used on the line in the form of a key to value map.
 std::unordered_map<std::string, MacroElement> getAllMacrosOnLine(
-    StringRef line, StringMap<MacroElement> macroMap) {
+    StringRef line, const StringMap<MacroElement> &macroMap) {
     // Transform macroMap into a second that will contain only macros that are
     // used on the line.
     // Note: For the purpose of the algorithm the starting line is treated as a
@@ -103,6 +108,120 @@ std::unordered_map<std::string, MacroElement> getAllMacrosOnLine(
     return usedMacroMap;
 }
 
+namespace {
+/// C source file kept in memory together with an index of its lines, so that
+/// statements can be extracted from it without reading the file repeatedly.
+/// Lines are indexed the same way as line_iterator visits them (i.e. blank
+/// lines are skipped).
+class SourceFile {
+  public:
+    SourceFile(std::unique_ptr<MemoryBuffer> Buffer,
+               const sys::fs::file_status &Status);
+
+    /// Get the statement that the line with the given number is part of.
+    std::string getStatement(unsigned LineNumber) const;
+
+    /// Check if the file is unchanged since it was read.
+    bool isUpToDate(const sys::fs::file_status &Status) const {
+        return Status.getLastModificationTime() == ModificationTime &&
+               Status.getSize() == Size;
+    }
+
+  private:
+    std::unique_ptr<MemoryBuffer> Buffer;
+    sys::TimePoint<> ModificationTime;
+    uint64_t Size;
+
+    /// Non-blank lines of the file.
+    std::vector<StringRef> Lines;
+    /// Numbers of opening and closing parentheses on each line.
+    std::vector<unsigned> Opening, Closing;
+    /// Index of the line in Lines for each line number (-1 for blank lines).
+    std::vector<int> LineIndices;
+    /// Index of the first line of the statement that each line belongs to.
+    std::vector<unsigned> StatementStarts;
+};
+}
+
+/// Build the index of lines of the file.
+SourceFile::SourceFile(std::unique_ptr<MemoryBuffer> Buffer,
+                       const sys::fs::file_status &Status)
+        : Buffer(std::move(Buffer)),
+          ModificationTime(Status.getLastModificationTime()),
+          Size(Status.getSize()) {
+    for (line_iterator it(*this->Buffer); !it.is_at_end(); ++it) {
+        if (LineIndices.size() <= (unsigned) it.line_number())
+            LineIndices.resize(it.line_number() + 1, -1);
+        LineIndices[it.line_number()] = Lines.size();
+
+        unsigned Index = Lines.size();
+        Lines.push_back(*it);
+        Opening.push_back(it->count('('));
+        Closing.push_back(it->count(')'));
+
+        // A line having more closing than opening parentheses is
+        // a continuation of the previous one. The first line of the file
+        // never starts a statement that can be continued.
+        if (Index > 0 && Opening[Index] < Closing[Index])
+            StatementStarts.push_back(
+                    Index > 1 ? StatementStarts[Index - 1] : Index);
+        else
+            StatementStarts.push_back(Index);
+    }
+}
+
+/// Get the statement that the line with the given number is part of.
+/// If the line is a continuation of the previous lines, these are included.
+/// If the statement is not finished on the line (it contains more opening than
+/// closing parentheses), the following lines are included.
+/// Note: the first non-blank line of the file is never returned.
+std::string SourceFile::getStatement(unsigned LineNumber) const {
+    if (LineNumber >= LineIndices.size() || LineIndices[LineNumber] <= 0)
+        return "";
+
+    unsigned Index = LineIndices[LineNumber];
+    std::string Statement;
+    unsigned Open = 0, Close = 0;
+    for (unsigned i = StatementStarts[Index]; i <= Index; i++) {
+        Statement += Lines[i];
+        Open += Opening[i];
+        Close += Closing[i];
+    }
+    // Unfinished line
+    for (unsigned i = Index + 1; i < Lines.size() && Close < Open; i++) {
+        Statement += Lines[i];
+        Open += Opening[i];
+        Close += Closing[i];
+    }
+    return Statement;
+}
+
+/// Get the source file with the given path. Each file is read only once
+/// (unless it changes) and it is kept in memory for the rest of the run.
+/// \return Source file or nullptr if the file cannot be read.
+static const SourceFile *getSourceFile(const std::string &Path) {
+    static StringMap<std::unique_ptr<SourceFile>> SourceFiles;
+    static std::mutex SourceFilesLock;
+    std::lock_guard<std::mutex> Guard(SourceFilesLock);
+
+    sys::fs::file_status Status;
+    if (sys::fs::status(Path, Status))
+        return nullptr;
+
+    auto &File = SourceFiles[Path];
+    if (!File || !File->isUpToDate(Status)) {
+        countStat(Counter::SourceFileReads);
+        auto Buffer = MemoryBuffer::getFile(Twine(Path));
+        if (Buffer.getError()) {
+            File.reset();
+            return nullptr;
+        }
+        File = std::unique_ptr<SourceFile>(
+                new SourceFile(std::move(*Buffer), Status));
+    }
+    return File.get();
+}
+
 /// Extract the line corresponding to the DILocation from the C source file.
 std::string extractLineFromLocation(DILocation *LineLoc) {
     // Get the path of the source file corresponding to the module where the
@@ -114,77 +233,31 @@ std::string extractLineFromLocation(DILocation *LineLoc) {
     auto sourcePath = getSourceFilePath(
             dyn_cast<DIScope>(LineLoc->getScope()));
 
-    // Open the C source file corresponding to the location and extract the line
-    auto sourceFile = MemoryBuffer::getFile(Twine(sourcePath));
-    if (sourceFile.getError()) {
+    // Get the C source file corresponding to the location and extract the line
+    // (the line may be extended to the whole statement by the source file).
+    auto sourceFile = getSourceFile(sourcePath);
+    if (!sourceFile) {
         // Source file was not found, return empty string
         return "";
     }
 
-    // Read the source file by lines, stop at the right number (the line that
-    // is referenced by the DILocation)
-    // The code also tries to include other lines belonging to the statement by
-    // counting parenthesis - in case the line is only a part of the statement,
-    // the other parts are added to it.
-    line_iterator it(**sourceFile);
-    std::string line, previousLine;
-    while (!it.is_at_end() && it.line_number() != (LineLoc->getLine())) {
-        ++it;
-        if (it->count('(') < it->count(')'))
-            // The line is a continuation of the previous one
-            line += it->str();
-        else {
-            previousLine = line;
-            line = it->str();
-        }
-    }
-    if (StringRef(line).count('(') > StringRef(line).count(')')) {
-        // Unfinished line
-        do {
-            ++it;
-            line += it->str();
-        } while (!it.is_at_end() && (StringRef(line).count(')') <
-                StringRef(line).count('(')));
-    }
-
-    return line;
+    return sourceFile->getStatement(LineLoc->getLine());
 }
 
-/// Gets all macros used on a certain DILocation in the form of a key to value
-/// map.
-std::unordered_map<std::string, MacroElement> getAllMacrosAtLocation(
-    DILocation *LineLoc, const Module *Mod) {
-    if (!LineLoc || LineLoc->getNumOperands() == 0) {
-        // DILocation has no scope or is not present - cannot get macro stack
-        DEBUG_WITH_TYPE(DEBUG_SIMPLL, dbgs() << "Scope for macro not found\n");
-        return std::unordered_map<std::string, MacroElement>();
-    }
-
-    std::string line = extractLineFromLocation(LineLoc);
-    if (line == "") {
-        // Source file was not found
-        DEBUG_WITH_TYPE(DEBUG_SIMPLL, dbgs() << "Source for macro not found\n");
-        return std::unordered_map<std::string, MacroElement>();
-    }
-
-    DEBUG_WITH_TYPE(DEBUG_SIMPLL,
-                    dbgs() << "Looking for all macros on line:" << line
-                    << "\n");
-
-    // Get macro array from debug info
-    DISubprogram *Sub = LineLoc->getScope()->getSubprogram();
-    DIMacroNodeArray RawMacros = Sub->getUnit()->getMacros();
-
-    // Create a map from macro identifiers to their values.
-    StringMap<MacroElement> macroMap;
-    StringMap<const DIMacroFile *> macroFileMap;
+/// Build the index of macros defined in the compile unit.
+static std::unique_ptr<MacroIndex> buildMacroIndex(const DICompileUnit *CU) {
+    std::unique_ptr<MacroIndex> Index(new MacroIndex());
     std::vector<const DIMacroFile *> macroFileStack;
 
     // First all DIMacroFiles (these represent directly included headers) are
-    // added to a stack.
-    for (const DIMacroNode *Node : RawMacros) {
+    // added to a stack. Macros defined directly in the compile unit are only
+    // added to the value index.
+    for (const DIMacroNode *Node : CU->getMacros()) {
         if (const DIMacroFile *File = dyn_cast<DIMacroFile>(Node))
             macroFileStack.push_back(File);
+        else if (const DIMacro *Macro = dyn_cast<DIMacro>(Node))
+            Index->UnitMacrosByValue[Macro->getValue()].push_back(
+                    Macro->getName());
     }
 
     // Next a DFS algorithm (using the stack created in the previous step) is
@@ -220,12 +293,67 @@ std::unordered_map<std::string, MacroElement> getAllMacrosAtLocation(
                 element.parentMacro = "N/A";
                 element.sourceFile = MF->getFile()->getFilename().str();
                 element.line = Macro->getLine();
-                macroMap[macroName] = element;
+                Index->Macros[macroName] = element;
             }
     }
+    DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                    dbgs() << "Built macro index of " << CU->getFilename()
+                           << " with " << Index->Macros.size()
+                           << " macros\n");
+    return Index;
+}
+
+/// Macro indices of compile units that have been queried so far.
+static DenseMap<const DICompileUnit *, std::unique_ptr<MacroIndex>>
+        MacroIndices;
+static std::mutex MacroIndicesMutex;
+
+/// Get the index of macros defined in the compile unit. The index is built
+/// when it is requested for the first time and then it is kept in memory
+/// until clearMacroIndices is called.
+const MacroIndex &getMacroIndex(const DICompileUnit *CU) {
+    std::lock_guard<std::mutex> Lock(MacroIndicesMutex);
+    auto &Index = MacroIndices[CU];
+    if (!Index)
+        Index = buildMacroIndex(CU);
+    return *Index;
+}
+
+/// Drop all macro indices. Must be called before the modules containing the
+/// indexed compile units are destroyed.
+void clearMacroIndices() {
+    std::lock_guard<std::mutex> Lock(MacroIndicesMutex);
+    MacroIndices.clear();
+}
+
+/// Gets all macros used on a certain DILocation in the form of a key to value
+/// map.
+std::unordered_map<std::string, MacroElement> getAllMacrosAtLocation(
+    DILocation *LineLoc, const Module *Mod) {
+    countStat(Counter::MacroLookups);
+    if (!LineLoc || LineLoc->getNumOperands() == 0) {
+        // DILocation has no scope or is not present - cannot get macro stack
+        DEBUG_WITH_TYPE(DEBUG_SIMPLL, dbgs() << "Scope for macro not found\n");
+        return std::unordered_map<std::string, MacroElement>();
+    }
+
+    std::string line = extractLineFromLocation(LineLoc);
+    if (line == "") {
+        // Source file was not found
+        DEBUG_WITH_TYPE(DEBUG_SIMPLL, dbgs() << "Source for macro not found\n");
+        return std::unordered_map<std::string, MacroElement>();
+    }
+
+    DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                    dbgs() << "Looking for all macros on line:" << line
+                    << "\n");
+
+    // Get the macro index of the compile unit
+    DISubprogram *Sub = LineLoc->getScope()->getSubprogram();
+    const MacroIndex &Index = getMacroIndex(Sub->getUnit());
 
     // Add information about the original line to the map, then return the map
-    auto macrosOnLine = getAllMacrosOnLine(line, macroMap);
+    auto macrosOnLine = getAllMacrosOnLine(line, Index.Macros);
     macrosOnLine[" "].sourceFile = getSourceFilePath(
             dyn_cast<DIScope>(LineLoc->getScope()));
     macrosOnLine[" "].line = LineLoc->getLine();
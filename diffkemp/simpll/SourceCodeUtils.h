@@ -22,6 +22,7 @@
 #include <llvm/IR/DebugInfoMetadata.h>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 using namespace llvm;
 
@@ -54,9 +55,27 @@ struct SyntaxDifference {
 	std::string function;
 };
 
+/// Index of macros defined in a compile unit.
+struct MacroIndex {
+    // All macros visible in the compile unit (i.e. defined in the included
+    // files) indexed by their names without arguments.
+    StringMap<MacroElement> Macros;
+    // Names of macros defined directly in the compile unit (e.g. on the
+    // command line) indexed by their values.
+    StringMap<std::vector<StringRef>> UnitMacrosByValue;
+};
+
+/// Get the index of macros defined in the compile unit. The index is built
+/// lazily and it is shared by all queries to the same compile unit.
+const MacroIndex &getMacroIndex(const DICompileUnit *CU);
+
+/// Drop all macro indices. Must be called before the modules containing the
+/// indexed compile units are destroyed.
+void clearMacroIndices();
+
 /// Gets all macros used on the line in the form of a key to value map.
 std::unordered_map<std::string, MacroElement> getAllMacrosOnLine(
-    StringRef line, StringMap<StringRef> macroMap);
+    StringRef line, const StringMap<MacroElement> &macroMap);
 
 /// Extract the line corresponding to the DILocation from the C source file.
 std::string extractLineFromLocation(DILocation *LineLoc);
@@ -0,0 +1,121 @@
+//===--------------- Stats.cpp - Statistics of SimpLL runs ----------------===//
+//
+//       SimpLL - Program simplifier for analysis of semantic difference      //
+//
+// This file is published under Apache 2.0 license. See LICENSE for details.
+// Author: Viktor Malik, vmalik@redhat.com
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementation of functions collecting statistics of
+/// SimpLL runs.
+///
+//===----------------------------------------------------------------------===//
+
+#include "Stats.h"
+#include <atomic>
+#include <mutex>
+#include <sys/resource.h>
+
+/// Names of the phases (in the order of the Phase values) used in the output.
+static const char *PhaseNames[] = {
+        "parsing", "preprocessing", "abstractions", "debug-info",
+        "comparison", "inlining", "output", "postprocessing", "writing"};
+static const unsigned PhaseCount = sizeof(PhaseNames) / sizeof(*PhaseNames);
+
+/// Names of the counters (in the order of the Counter values) used in
+/// the output.
+static const char *CounterNames[] = {
+        "functions-compared", "instructions-compared", "inlining-attempts",
+        "macro-lookups", "source-file-reads"};
+static const unsigned CounterCount =
+        sizeof(CounterNames) / sizeof(*CounterNames);
+
+// Statistics are enabled before any work (and any thread) is started, hence
+// the flag itself does not need to be atomic.
+static bool Enabled = false;
+static std::atomic<uint64_t> Counters[CounterCount];
+// Phases are measured by the main thread only but the lock makes it safe to
+// time phases running in other threads as well.
+static TimeRecord PhaseTimes[PhaseCount];
+static std::mutex PhaseTimesLock;
+// The innermost running timer of the current thread.
+static thread_local PhaseTimer *InnermostTimer = nullptr;
+
+/// Enable collecting of the statistics.
+void enableStats() {
+    Enabled = true;
+}
+
+/// Check if the statistics are collected.
+bool statsEnabled() {
+    return Enabled;
+}
+
+/// Reset all counters and times of all phases.
+void resetStats() {
+    for (auto &Value : Counters)
+        Value = 0;
+    std::lock_guard<std::mutex> Guard(PhaseTimesLock);
+    for (auto &Time : PhaseTimes)
+        Time = TimeRecord();
+}
+
+/// Increase the value of the counter (if the statistics are enabled).
+void countStat(Counter C, uint64_t N) {
+    if (Enabled)
+        Counters[static_cast<unsigned>(C)].fetch_add(
+                N, std::memory_order_relaxed);
+}
+
+/// Start measuring the phase (if the statistics are enabled).
+PhaseTimer::PhaseTimer(Phase P) : P(P), Running(Enabled) {
+    if (Running) {
+        Enclosing = InnermostTimer;
+        InnermostTimer = this;
+        Start = TimeRecord::getCurrentTime(true);
+    }
+}
+
+/// Stop the timer and add the measured time to the phase. The time of
+/// the nested phases is subtracted from the time of the phase and the whole
+/// measured time is passed to the enclosing phase to be subtracted from it.
+/// Stopping the timer again has no effect.
+void PhaseTimer::stop() {
+    if (!Running)
+        return;
+    Running = false;
+    TimeRecord Time = TimeRecord::getCurrentTime(false);
+    Time -= Start;
+    InnermostTimer = Enclosing;
+    if (Enclosing)
+        Enclosing->Nested += Time;
+    Time -= Nested;
+    std::lock_guard<std::mutex> Guard(PhaseTimesLock);
+    PhaseTimes[static_cast<unsigned>(P)] += Time;
+}
+
+/// Get the peak resident set size of the process in kB (0 if it is not known).
+static uint64_t getPeakRSS() {
+    struct rusage Usage;
+    if (getrusage(RUSAGE_SELF, &Usage))
+        return 0;
+    return Usage.ru_maxrss;
+}
+
+/// Get the statistics collected since the last reset together with the current
+/// peak RSS of the process.
+StatsReport getStats() {
+    StatsReport Report;
+    {
+        std::lock_guard<std::mutex> Guard(PhaseTimesLock);
+        for (unsigned i = 0; i < PhaseCount; i++)
+            Report.Phases.push_back({PhaseNames[i],
+                                     PhaseTimes[i].getWallTime(),
+                                     PhaseTimes[i].getProcessTime()});
+    }
+    for (unsigned i = 0; i < CounterCount; i++)
+        Report.Counters.push_back({CounterNames[i], Counters[i].load()});
+    Report.PeakRSS = getPeakRSS();
+    return Report;
+}
@@ -0,0 +1,109 @@
+//===---------------- Stats.h - Statistics of SimpLL runs -----------------===//
+//
+//       SimpLL - Program simplifier for analysis of semantic difference      //
+//
+// This file is published under Apache 2.0 license. See LICENSE for details.
+// Author: Viktor Malik, vmalik@redhat.com
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the declaration of functions collecting statistics of
+/// SimpLL runs (times of individual phases and counters of the done work).
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef DIFFKEMP_SIMPLL_STATS_H
+#define DIFFKEMP_SIMPLL_STATS_H
+
+#include <llvm/Support/Timer.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+/// Phases of the simplification whose duration is measured.
+enum class Phase {
+    Parsing,
+    Preprocessing,
+    Abstractions,
+    DebugInfo,
+    Comparison,
+    Inlining,
+    Output,
+    Postprocessing,
+    Writing
+};
+
+/// Counters of the work done during the simplification.
+enum class Counter {
+    FunctionsCompared,
+    InstructionsCompared,
+    InliningAttempts,
+    MacroLookups,
+    SourceFileReads
+};
+
+/// Enable collecting of the statistics (--stats option). Unless the statistics
+/// are enabled, recording them does nothing.
+void enableStats();
+
+/// Check if the statistics are collected.
+bool statsEnabled();
+
+/// Reset all statistics (done at the beginning of each run).
+void resetStats();
+
+/// Increase the value of the counter. Can be called from multiple threads.
+void countStat(Counter C, uint64_t N = 1);
+
+/// Timer measuring the wall and the CPU time of a phase. The phase lasts from
+/// the construction of the timer until the timer is stopped or destroyed.
+/// Time of nested phases (e.g. inlining during the comparison) is not included
+/// in the time of the enclosing phase, hence the times of all phases can be
+/// summed. Timers running in one thread must be stopped in the reverse order
+/// of their construction.
+class PhaseTimer {
+  public:
+    PhaseTimer(Phase P);
+    ~PhaseTimer() { stop(); }
+
+    /// Stop the timer and add the measured time to the phase.
+    void stop();
+
+  private:
+    Phase P;
+    bool Running;
+    TimeRecord Start;
+    /// Time of the phases nested in this one.
+    TimeRecord Nested;
+    /// Timer of the enclosing phase (NULL if there is none).
+    PhaseTimer *Enclosing = nullptr;
+};
+
+/// Times of a single phase (in seconds).
+struct PhaseStats {
+    std::string Name;
+    double WallTime;
+    double CPUTime;
+};
+
+/// Value of a single counter.
+struct CounterStats {
+    std::string Name;
+    uint64_t Value;
+};
+
+/// Snapshot of the collected statistics.
+struct StatsReport {
+    std::vector<PhaseStats> Phases;
+    std::vector<CounterStats> Counters;
+    /// Peak resident set size of the process (in kB). In the server mode, this
+    /// is the peak over all processed requests.
+    uint64_t PeakRSS;
+};
+
+/// Get the statistics collected since the last reset.
+StatsReport getStats();
+
+#endif // DIFFKEMP_SIMPLL_STATS_H
@@ -0,0 +1,243 @@
+//===-------- SymbolIndex.cpp - Index of modules defining symbols ---------===//
+//
+//       SimpLL - Program simplifier for analysis of semantic difference      //
+//
+// This file is published under Apache 2.0 license. See LICENSE for details.
+// Author: Viktor Malik, vmalik@redhat.com
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementation of the index of modules defining
+/// functions and of linking of missing function definitions.
+///
+//===----------------------------------------------------------------------===//
+
+#include "SymbolIndex.h"
+#include "Config.h"
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/Debug.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/LineIterator.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/YAMLTraits.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO.h>
+
+/// Single entry of the index file.
+struct SymbolDefinition {
+    std::string Symbol;
+    std::string Module;
+};
+
+// SymbolDefinition to/from YAML
+namespace llvm::yaml {
+template<>
+struct MappingTraits<SymbolDefinition> {
+    static void mapping(IO &io, SymbolDefinition &def) {
+        io.mapRequired("symbol", def.Symbol);
+        io.mapRequired("module", def.Module);
+    }
+};
+}
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(SymbolDefinition);
+
+/// Get the file that the module should be loaded from. If there is an up to
+/// date bitcode version of a textual IR file, the bitcode is used since it can
+/// be loaded lazily.
+static std::string getInputFile(StringRef File) {
+    if (!File.endswith(".ll"))
+        return File;
+    std::string Bitcode = (File.drop_back(3) + ".bc").str();
+    sys::fs::file_status TextStatus, BitcodeStatus;
+    if (!sys::fs::status(File, TextStatus) &&
+            !sys::fs::status(Bitcode, BitcodeStatus) &&
+            BitcodeStatus.getLastModificationTime() >=
+                    TextStatus.getLastModificationTime())
+        return Bitcode;
+    return File;
+}
+
+/// Get names of all symbols (functions, global variables, and aliases) that
+/// are defined in the module stored in the file and that are visible outside
+/// of the module.
+/// \return False if the module could not be loaded.
+static bool getDefinedSymbols(StringRef File,
+                              std::vector<std::string> &Symbols) {
+    LLVMContext Context;
+    SMDiagnostic Err;
+    auto Mod = getLazyIRFileModule(getInputFile(File), Err, Context);
+    if (!Mod)
+        return false;
+    for (auto &Fun : *Mod) {
+        if (!Fun.isDeclaration() && !Fun.hasLocalLinkage())
+            Symbols.push_back(Fun.getName());
+    }
+    for (auto &Glob : Mod->globals()) {
+        if (!Glob.isDeclaration() && !Glob.hasLocalLinkage())
+            Symbols.push_back(Glob.getName());
+    }
+    for (auto &Alias : Mod->aliases()) {
+        if (!Alias.hasLocalLinkage())
+            Symbols.push_back(Alias.getName());
+    }
+    return true;
+}
+
+/// Load the index from a file or create it from modules in a directory.
+bool SymbolIndex::load(const std::string &Path) {
+    if (sys::fs::is_directory(Path))
+        return loadDirectory(Path);
+    return loadFile(Path);
+}
+
+/// Get the file with the module defining the symbol.
+std::string SymbolIndex::lookup(StringRef Symbol) const {
+    auto Entry = Modules.find(Symbol);
+    if (Entry == Modules.end())
+        return "";
+    return Entry->second;
+}
+
+/// Load the index from a YAML file. Relative paths of modules are taken
+/// relative to the directory containing the index file.
+bool SymbolIndex::loadFile(const std::string &File) {
+    auto Buffer = MemoryBuffer::getFile(File);
+    if (!Buffer)
+        return false;
+
+    std::vector<SymbolDefinition> Definitions;
+    llvm::yaml::Input input((*Buffer)->getBuffer());
+    input >> Definitions;
+    if (input.error())
+        return false;
+
+    StringRef Dir = sys::path::parent_path(File);
+    for (auto &Def : Definitions) {
+        SmallString<128> ModulePath(Def.Module);
+        if (sys::path::is_relative(ModulePath)) {
+            ModulePath = Dir;
+            sys::path::append(ModulePath, Def.Module);
+        }
+        Modules.insert({Def.Symbol, ModulePath.str()});
+    }
+    DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                    dbgs() << "Loaded " << Modules.size()
+                           << " symbols from " << File << "\n");
+    return true;
+}
+
+/// Index all modules in the directory (recursively). If a module is stored
+/// both as textual IR and as bitcode, it is indexed only once. If a symbol is
+/// defined in multiple modules, the first found module is used.
+bool SymbolIndex::loadDirectory(const std::string &Dir) {
+    std::error_code EC;
+    for (sys::fs::recursive_directory_iterator File(Dir, EC), End;
+         File != End && !EC; File.increment(EC)) {
+        StringRef Path = File->path();
+        if (!Path.endswith(".ll") && !Path.endswith(".bc"))
+            continue;
+        if (Path.endswith(".bc") &&
+                sys::fs::exists(Path.drop_back(3) + ".ll"))
+            continue;
+
+        std::vector<std::string> Symbols;
+        if (!getDefinedSymbols(Path, Symbols))
+            continue;
+        for (auto &Symbol : Symbols)
+            Modules.insert({Symbol, Path});
+    }
+    DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                    dbgs() << "Indexed " << Modules.size()
+                           << " symbols in " << Dir << "\n");
+    return !EC;
+}
+
+/// Link definitions of the given functions into the module.
+/// Only functions that are declarations in the module are searched for. Each
+/// module defining some of them is linked once and only the globals needed by
+/// the linked-to module are linked. Afterwards, duplicate constants and
+/// functions are merged (the same way as 'opt -constmerge -mergefunc' does
+/// after linking modules in DiffKemp).
+bool linkDefinitions(Module &Mod, const std::set<std::string> &Functions,
+                     const SymbolIndex &Index) {
+    std::vector<std::string> Missing;
+    std::set<std::string> Files;
+    for (auto &Name : Functions) {
+        Function *Fun = Mod.getFunction(Name);
+        if (!Fun || !Fun->isDeclaration())
+            continue;
+        std::string File = Index.lookup(Name);
+        if (File.empty())
+            continue;
+        Missing.push_back(Name);
+        Files.insert(File);
+    }
+
+    bool Linked = false;
+    for (auto &File : Files) {
+        SMDiagnostic Err;
+        auto Src = getLazyIRFileModule(getInputFile(File), Err,
+                                       Mod.getContext());
+        if (!Src) {
+            DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                            dbgs() << "Cannot parse " << File << "\n");
+            continue;
+        }
+        if (Linker::linkModules(Mod, std::move(Src),
+                                Linker::Flags::LinkOnlyNeeded)) {
+            DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                            dbgs() << "Cannot link " << File << "\n");
+            continue;
+        }
+        DEBUG_WITH_TYPE(DEBUG_SIMPLL, dbgs() << "Linked " << File << "\n");
+        Linked = true;
+    }
+    if (!Linked)
+        return false;
+
+    // MergeFunctions is not available in the new pass manager.
+    legacy::PassManager PM;
+    PM.add(createConstantMergePass());
+    PM.add(createMergeFunctionsPass());
+    PM.run(Mod);
+
+    for (auto &Name : Missing) {
+        Function *Fun = Mod.getFunction(Name);
+        if (Fun && !Fun->isDeclaration())
+            return true;
+    }
+    return false;
+}
+
+/// Print the index of symbols defined by the modules listed in the file.
+int writeSymbolIndex(const std::string &ModuleList) {
+    auto Buffer = MemoryBuffer::getFile(ModuleList);
+    if (!Buffer) {
+        errs() << "Cannot read module list " << ModuleList << "\n";
+        return 1;
+    }
+
+    std::vector<SymbolDefinition> Definitions;
+    for (line_iterator Line(**Buffer); !Line.is_at_end(); ++Line) {
+        StringRef File = Line->trim();
+        if (File.empty())
+            continue;
+        std::vector<std::string> Symbols;
+        if (!getDefinedSymbols(File, Symbols)) {
+            errs() << "Cannot parse " << File << "\n";
+            continue;
+        }
+        for (auto &Symbol : Symbols)
+            Definitions.push_back({Symbol, File});
+    }
+
+    llvm::yaml::Output output(outs());
+    output << Definitions;
+    return 0;
+}
@@ -0,0 +1,65 @@
+//===--------- SymbolIndex.h - Index of modules defining symbols ----------===//
+//
+//       SimpLL - Program simplifier for analysis of semantic difference      //
+//
+// This file is published under Apache 2.0 license. See LICENSE for details.
+// Author: Viktor Malik, vmalik@redhat.com
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the declaration of the index of modules defining
+/// functions and of linking of missing function definitions.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef DIFFKEMP_SIMPLL_SYMBOLINDEX_H
+#define DIFFKEMP_SIMPLL_SYMBOLINDEX_H
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/IR/Module.h>
+#include <set>
+
+using namespace llvm;
+
+/// Index mapping names of symbols (functions and global variables) to files
+/// with modules that define them.
+/// The index can be either loaded from a YAML file or created by scanning
+/// a directory containing LLVM modules.
+/// The YAML file contains a list of entries of the form
+///   - symbol: <name>
+///     module: <file>
+/// where file paths are relative to the directory containing the index.
+/// Such file can be created using writeSymbolIndex.
+class SymbolIndex {
+  public:
+    /// Load the index from a file or create it from modules in a directory.
+    /// \return False if the index could not be loaded.
+    bool load(const std::string &Path);
+
+    /// Get the file with the module defining the symbol.
+    /// \return File name or an empty string if the symbol is not indexed.
+    std::string lookup(StringRef Symbol) const;
+
+  private:
+    StringMap<std::string> Modules;
+
+    /// Load the index from a YAML file.
+    bool loadFile(const std::string &File);
+    /// Index all modules in the directory (recursively).
+    bool loadDirectory(const std::string &Dir);
+};
+
+/// Link definitions of the given functions into the module. Modules defining
+/// the functions are found using the index, only the needed parts of the
+/// modules are linked.
+/// \return True if at least one definition was linked.
+bool linkDefinitions(Module &Mod, const std::set<std::string> &Functions,
+                     const SymbolIndex &Index);
+
+/// Print the index of symbols defined by the modules listed in the file (one
+/// module per line) to stdout in the format used by SymbolIndex. Paths of the
+/// modules are printed as they are listed.
+/// \return Exit code of the program.
+int writeSymbolIndex(const std::string &ModuleList);
+
+#endif // DIFFKEMP_SIMPLL_SYMBOLINDEX_H
@@ -17,6 +17,11 @@
 #include "DifferentialGlobalNumberState.h"
 #include "DifferentialFunctionComparator.h"
 #include "ModuleComparator.h"
+#include "Output.h"
+#include "ResultsCache.h"
+#include "SourceCodeUtils.h"
+#include "Stats.h"
+#include "SymbolIndex.h"
 #include "Utils.h"
 #include "passes/CalledFunctionsAnalysis.h"
 #include "passes/ControlFlowSlicer.h"
@@ -24,6 +29,7 @@
 #include "passes/ReduceFunctionMetadataPass.h"
 #include "passes/RemoveLifetimeCallsPass.h"
 #include "passes/RemoveUnusedReturnValuesPass.h"
+#include "passes/SideEffectSummaryAnalysis.h"
 #include "passes/SimplifyKernelFunctionCallsPass.h"
 #include "passes/SimplifyKernelGlobalsPass.h"
 #include "passes/StructureSizeAnalysis.h"
@@ -32,8 +38,122 @@
 #include <llvm/IR/PassManager.h>
 #include <llvm/Passes/PassBuilder.h>
 #include <llvm/Transforms/IPO/AlwaysInliner.h>
+#include <llvm/Transforms/IPO/DeadArgumentElimination.h>
+#include <llvm/Transforms/IPO/GlobalDCE.h>
 #include <llvm/Transforms/Scalar/DCE.h>
 #include <llvm/Transforms/Scalar/LowerExpectIntrinsic.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <thread>
+
+/// Collect all functions that are transitively referenced from the function
+/// (either called or used as an operand).
+static void collectReachableFunctions(const Function *Fun,
+                                      std::set<const Function *> &Reachable) {
+    std::set<const Constant *> Visited;
+    std::vector<const Function *> Worklist = {Fun};
+    while (!Worklist.empty()) {
+        const Function *Current = Worklist.back();
+        Worklist.pop_back();
+        if (!Reachable.insert(Current).second)
+            continue;
+        for (auto &BB : *Current)
+            for (auto &Inst : BB)
+                for (auto &Op : Inst.operands())
+                    collectReferencedFunctions(Op.get(), Visited, Worklist);
+    }
+}
+
+/// Add the function passes of the preprocessing (steps 2-5 below) into
+/// the pass manager.
+static void addFunctionSimplifications(FunctionPassManager &fpm,
+                                       bool ControlFlowOnly) {
+    if (ControlFlowOnly)
+        fpm.addPass(ControlFlowSlicer {});
+    fpm.addPass(SimplifyKernelFunctionCallsPass{});
+    fpm.addPass(UnifyMemcpyPass {});
+    fpm.addPass(DCEPass {});
+    fpm.addPass(LowerExpectIntrinsicPass {});
+    fpm.addPass(ReduceFunctionMetadataPass {});
+}
+
+/// Register the analyses used by the passes of the preprocessing.
+/// Function passes can get module analyses (the summary of side effects used
+/// by ControlFlowSlicer) through the module analysis manager proxy.
+static void registerPreprocessingAnalyses(PassBuilder &pb,
+                                          FunctionAnalysisManager &fam,
+                                          ModuleAnalysisManager &mam) {
+    pb.registerFunctionAnalyses(fam);
+    pb.registerModuleAnalyses(mam);
+    mam.registerPass([] { return SideEffectSummaryAnalysis(); });
+    fam.registerPass([&mam] {
+        return ModuleAnalysisManagerFunctionProxy(mam);
+    });
+}
+
+/// Slice the function w.r.t. the value of a global variable (step 1 of
+/// the preprocessing).
+static void sliceByVariable(Function *Fun, GlobalVariable *Var) {
+    PassManager<Function, FunctionAnalysisManager, GlobalVariable *> fpm;
+    FunctionAnalysisManager fam(false);
+    PassBuilder pb;
+    pb.registerFunctionAnalyses(fam);
+
+    fpm.addPass(VarDependencySlicer {});
+    fpm.run(*Fun, fam, Var);
+}
+
+/// Run the function passes of the preprocessing (steps 2-5 of
+/// preprocessModule) on all functions reachable from the given roots (on all
+/// functions if there are no roots) and then run the module passes.
+/// If only the control flow is kept, side effects of all functions are
+/// summarized once before ControlFlowSlicer slices any function. Calls are
+/// therefore kept if the original body of the callee has a side effect, even
+/// if the callee is sliced first and the slicing removes the side effect
+/// (e.g. a store). The result does not depend on the order of functions.
+static void simplifyReachableFunctions(Module &Mod,
+                                       const std::vector<Function *> &Roots,
+                                       bool ControlFlowOnly,
+                                       bool DropUnreachable) {
+    // Function passes
+    FunctionPassManager fpm(false);
+    ModuleAnalysisManager mam(false);
+    FunctionAnalysisManager fam(false);
+    PassBuilder pb;
+    registerPreprocessingAnalyses(pb, fam, mam);
+    if (ControlFlowOnly)
+        mam.getResult<SideEffectSummaryAnalysis>(Mod);
+    addFunctionSimplifications(fpm, ControlFlowOnly);
+
+    // Reachable functions are collected after the slicing since it may remove
+    // some calls.
+    std::set<const Function *> Reachable;
+    for (auto *Root : Roots)
+        collectReachableFunctions(Root, Reachable);
+
+    for (auto &Fun : Mod) {
+        if (!Roots.empty() && Reachable.find(&Fun) == Reachable.end()) {
+            if (DropUnreachable && !Fun.isDeclaration()) {
+                deleteAliasToFun(Mod, &Fun);
+                Fun.deleteBody();
+            }
+            continue;
+        }
+        fpm.run(Fun, fam);
+    }
+    if (!Roots.empty()) {
+        DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                        dbgs() << "Preprocessed " << Reachable.size()
+                               << " reachable functions of "
+                               << Mod.getName() << "\n");
+    }
+
+    // Module passes
+    ModulePassManager mpm(false);
+    mpm.addPass(SimplifyKernelGlobalsPass {});
+    mpm.addPass(RemoveLifetimeCallsPass {});
+
+    mpm.run(Mod, mam);
+}
 
 /// Preprocessing functions run on each module at the beginning.
 /// The following transformations are applied:
@@ -47,47 +167,107 @@
 /// 3. Unification of memcpy variants so that all use the llvm.memcpy intrinsic.
 /// 4. Dead code elimination.
 /// 5. Removing calls to llvm.expect.
+/// If the compared function is known, the function passes are run only on
+/// the functions reachable from it since no other function can be compared.
 void preprocessModule(Module &Mod,
                       Function *Main,
                       GlobalVariable *Var,
-                      bool ControlFlowOnly) {
-    if (Var) {
-        // Slicing of the program w.r.t. the value of a global variable
-        PassManager<Function, FunctionAnalysisManager, GlobalVariable *> fpm;
-        FunctionAnalysisManager fam(false);
-        PassBuilder pb;
-        pb.registerFunctionAnalyses(fam);
+                      bool ControlFlowOnly,
+                      bool DropUnreachable) {
+    if (Var)
+        sliceByVariable(Main, Var);
 
-        fpm.addPass(VarDependencySlicer {});
-        fpm.run(*Main, fam, Var);
-    }
+    std::vector<Function *> Roots;
+    if (Main)
+        Roots.push_back(Main);
+    simplifyReachableFunctions(Mod, Roots, ControlFlowOnly, DropUnreachable);
+}
 
-    // Function passes
-    FunctionPassManager fpm(false);
-    FunctionAnalysisManager fam(false);
-    PassBuilder pb;
-    pb.registerFunctionAnalyses(fam);
+/// Compare all pairs of functions from the function list (batch mode).
+/// All pairs are compared using the same module comparator, hence functions
+/// that are called from multiple compared functions are compared only once.
+/// Results of the module comparator are then split between the compared
+/// functions based on which functions are reachable from each of them.
+/// The compared functions of the configuration are restored afterwards.
+static void compareFunctionList(Config &config,
+                                ModuleComparator &modComp,
+                                std::vector<ComparisonResult> &Results) {
+    std::string MainFuns;
+    if (config.FirstFun && config.SecondFun)
+        MainFuns = (config.FirstFun->getName() + "," +
+                    config.SecondFun->getName()).str();
 
-    if (ControlFlowOnly)
-        fpm.addPass(ControlFlowSlicer {});
-    fpm.addPass(SimplifyKernelFunctionCallsPass{});
-    fpm.addPass(UnifyMemcpyPass {});
-    fpm.addPass(DCEPass {});
-    fpm.addPass(LowerExpectIntrinsicPass {});
-    fpm.addPass(ReduceFunctionMetadataPass {});
+    // Reachable functions must be collected before any comparison is done
+    // since the comparison may inline some calls.
+    std::vector<std::set<const Function *>> Reachable;
+    for (auto &Entry : config.FunctionList) {
+        config.setFunctionNames(Entry);
+        Results.emplace_back(config.FirstFun, config.SecondFun);
+        Results.back().Name = Entry;
 
-    for (auto &Fun : Mod)
-        fpm.run(Fun, fam);
+        Reachable.emplace_back();
+        if (config.FirstFun)
+            collectReachableFunctions(config.FirstFun, Reachable.back());
+        if (config.SecondFun)
+            collectReachableFunctions(config.SecondFun, Reachable.back());
+    }
+    config.setFunctionNames(MainFuns);
 
-    // Module passes
-    ModulePassManager mpm(false);
-    ModuleAnalysisManager mam(false);
-    pb.registerModuleAnalyses(mam);
+    for (auto &Result : Results) {
+        if (!Result.FirstFun || !Result.SecondFun)
+            continue;
+        // Functions may have been compared already as callees of some
+        // previously compared functions.
+        if (modComp.ComparedFuns.find({Result.FirstFun, Result.SecondFun})
+                == modComp.ComparedFuns.end())
+            modComp.compareFunctions(Result.FirstFun, Result.SecondFun);
+    }
 
-    mpm.addPass(SimplifyKernelGlobalsPass {});
-    mpm.addPass(RemoveLifetimeCallsPass {});
+    for (unsigned i = 0; i < Results.size(); i++) {
+        auto &Result = Results[i];
+        auto &ReachableFuns = Reachable[i];
+        DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                        dbgs() << "Syntactic comparison results for "
+                               << Result.Name << ":\n");
+        if (!Result.FirstFun || !Result.SecondFun) {
+            // One of the functions does not exist
+            Result.missingDefs.emplace_back(Result.FirstFun,
+                                            Result.SecondFun);
+            continue;
+        }
 
-    mpm.run(Mod, mam);
+        std::set<StringRef> ReachableNames;
+        for (auto *Fun : ReachableFuns)
+            ReachableNames.insert(Fun->getName());
+
+        for (auto &funPair : modComp.ComparedFuns) {
+            if (funPair.second == ModuleComparator::NOT_EQUAL &&
+                    ReachableFuns.find(funPair.first.first) !=
+                            ReachableFuns.end()) {
+                Result.nonequalFuns.emplace_back(funPair.first.first,
+                                                 funPair.first.second);
+                DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                                dbgs() << funPair.first.first->getName()
+                                       << " are syntactically different\n");
+            }
+        }
+        for (auto &missingDef : modComp.MissingDefs) {
+            if ((missingDef.first && ReachableFuns.find(missingDef.first) !=
+                                             ReachableFuns.end()) ||
+                    (missingDef.second &&
+                            ReachableFuns.find(missingDef.second) !=
+                                    ReachableFuns.end()))
+                Result.missingDefs.push_back(missingDef);
+        }
+        for (auto &synDiff : modComp.DifferingObjects) {
+            if (ReachableNames.find(synDiff.function) != ReachableNames.end())
+                Result.differingObjects.push_back(synDiff);
+        }
+        for (auto &unknown : modComp.UnknownReasons) {
+            if (ReachableFuns.find(unknown.first.first) != ReachableFuns.end())
+                Result.unknownFuns.push_back(unknown);
+        }
+    }
 }
 
 /// Simplification of modules to ease the semantic diff.
@@ -98,16 +278,24 @@ void preprocessModule(Module &Mod,
 ///    functions.
 /// 2. Transformation of functions returning a value into void functions in case
 ///    the return value is never used within the module.
-/// 3. Using debug information to compute offsets of the corresponding GEP
-///    indices. Offsets are stored inside LLVM metadata.
+/// 3. Collecting debug information of the functions that may be compared
+///    (used to align corresponding GEP indices and macro values).
 /// 4. Removing bodies of functions that are syntactically equivalent.
+/// In the batch mode, the compared functions are not known during the
+/// simplification (all functions are simplified), the function bodies are not
+/// removed since the functions may be needed by other compared functions.
+/// The same holds for the multi-variable mode in which the sliced copies of
+/// the compared functions are compared in the batch mode.
 void simplifyModulesDiff(Config &config,
-                         std::vector<FunPair> &nonequalFuns,
-                         std::vector<ConstFunPair> &missingDefs,
-                         std::vector<SyntaxDifference> &differingMacros) {
+                         std::vector<ComparisonResult> &Results) {
+    bool Batch = !config.FunctionList.empty();
+    Function *MainFirst = Batch ? nullptr : config.FirstFun;
+    Function *MainSecond = Batch ? nullptr : config.SecondFun;
+
     // Generate abstractions of indirect function calls and for inline
     // assemblies. Then, unify the abstractions between the modules so that
     // the corresponding abstractions get the same name.
+    PhaseTimer AbstractionsTimer(Phase::Abstractions);
     AnalysisManager<Module, Function *> mam(false);
     mam.registerPass([] { return CalledFunctionsAnalysis(); });
     mam.registerPass([] { return FunctionAbstractionsGenerator(); });
@@ -115,55 +303,76 @@ void simplifyModulesDiff(Config &config,
 
     auto AbstractionGeneratorResultL =
             mam.getResult<FunctionAbstractionsGenerator>(*config.First,
-                    config.FirstFun);
+                    MainFirst);
     auto AbstractionGeneratorResultR =
             mam.getResult<FunctionAbstractionsGenerator>(*config.Second,
-                    config.SecondFun);
+                    MainSecond);
     unifyFunctionAbstractions(AbstractionGeneratorResultL,
                               AbstractionGeneratorResultR);
+    AbstractionsTimer.stop();
 
     auto StructSizeMapL = mam.getResult<StructureSizeAnalysis>(*config.First,
-            config.FirstFun);
+            MainFirst);
     auto StructSizeMapR = mam.getResult<StructureSizeAnalysis>(*config.Second,
-            config.SecondFun);
+            MainSecond);
 
     // Module passes
     PassManager<Module, AnalysisManager<Module, Function *>, Function *,
         Module *> mpm;
     mpm.addPass(RemoveUnusedReturnValuesPass {});
-    mpm.run(*config.First, mam, config.FirstFun, config.Second.get());
-    mpm.run(*config.Second, mam, config.SecondFun, config.First.get());
+    mpm.run(*config.First, mam, MainFirst, config.Second.get());
+    mpm.run(*config.Second, mam, MainSecond, config.First.get());
 
     // Refreshing main functions is necessary because they can be replaced with
     // a new version by a pass
     config.refreshFunctions();
 
-    DebugInfo DI(*config.First, *config.Second,
-                 config.FirstFun, config.SecondFun,
+    PhaseTimer DebugInfoTimer(Phase::DebugInfo);
+    DebugInfo DI(*config.First, *config.Second, MainFirst, MainSecond,
                  mam.getResult<CalledFunctionsAnalysis>(*config.First,
-                                                        config.FirstFun));
-    DEBUG_WITH_TYPE(DEBUG_SIMPLL,
-                    dbgs() << "StructFieldNames size: "
-                           << DI.StructFieldNames.size() << "\n");
+                                                        MainFirst),
+                 mam.getResult<CalledFunctionsAnalysis>(*config.Second,
+                                                        MainSecond),
+                 config.DropDebugInfo);
+    DebugInfoTimer.stop();
 
     // Compare functions for syntactical equivalence
+    std::unique_ptr<ResultsCache> Cache;
+    if (!config.CacheDir.empty())
+        Cache = std::unique_ptr<ResultsCache>(
+                new ResultsCache(config.CacheDir));
     ModuleComparator modComp(*config.First, *config.Second,
                              config.ControlFlowOnly, &DI,
                              AbstractionGeneratorResultL.asmValueMap,
                              AbstractionGeneratorResultR.asmValueMap,
-                             StructSizeMapL, StructSizeMapR);
+                             StructSizeMapL, StructSizeMapR, Cache.get(),
+                             config.Inlining, config.ResumeAfterInlining);
 
+    // Lasts until the end of the function (for all modes).
+    PhaseTimer ComparisonTimer(Phase::Comparison);
+    if (Batch) {
+        compareFunctionList(config, modComp, Results);
+        // In the multi-variable mode, there is one entry for each variable.
+        for (unsigned i = 0; i < config.VariableList.size(); i++) {
+            Results[i].Name.clear();
+            Results[i].Variable = config.VariableList[i];
+        }
+        return;
+    }
+
+    Results.emplace_back(config.FirstFun, config.SecondFun);
+    auto &Result = Results.back();
     if (config.FirstFun && config.SecondFun) {
         modComp.compareFunctions(config.FirstFun, config.SecondFun);
 
         DEBUG_WITH_TYPE(DEBUG_SIMPLL,
                         dbgs() << "Syntactic comparison results:\n");
-        bool allEqual = true;
+        bool allEqual = modComp.UnknownReasons.empty();
         for (auto &funPair : modComp.ComparedFuns) {
             if (funPair.second == ModuleComparator::NOT_EQUAL) {
                 allEqual = false;
-                nonequalFuns.emplace_back(funPair.first.first,
-                                          funPair.first.second);
+                Result.nonequalFuns.emplace_back(funPair.first.first,
+                                                 funPair.first.second);
                 DEBUG_WITH_TYPE(DEBUG_SIMPLL,
                                 dbgs() << funPair.first.first->getName()
                                        << " are syntactically different\n");
@@ -190,8 +399,10 @@ void simplifyModulesDiff(Config &config,
         }
     }
 
-    missingDefs = modComp.MissingDefs;
-    differingMacros = modComp.DifferingObjects;
+    Result.missingDefs = modComp.MissingDefs;
+    Result.differingObjects = modComp.DifferingObjects;
+    Result.unknownFuns.assign(modComp.UnknownReasons.begin(),
+                              modComp.UnknownReasons.end());
 }
 
 /// Recursively mark callees of a function with 'alwaysinline' attribute.
@@ -221,11 +432,13 @@ void markCalleesAlwaysInline(Function &Fun,
     }
 }
 
-/// Preprocessing functions run on each module at the beginning.
+/// Postprocessing functions run on each module before it is written.
 /// The following transformations are applied:
-/// 1. Removing debugging information.
-///    TODO this should be configurable via CLI option.
-/// 2. Inlining all functions called by the analysed function (if possible).
+/// 1. Inlining all functions called by the analysed functions (if possible).
+/// 2. Removing bodies of functions that are not reachable from the analysed
+///    functions and removing unused globals. Only the analysed functions and
+///    their callees are needed by the semantic diff.
+/// 3. Dead argument elimination.
 void postprocessModule(Module &Mod, const std::set<Function *> &MainFuns) {
     if (MainFuns.empty())
         return;
@@ -251,4 +464,219 @@ void postprocessModule(Module &Mod, const std::set<Function *> &MainFuns) {
     pb.registerModuleAnalyses(mam);
     mpm.addPass(AlwaysInlinerPass {});
     mpm.run(Mod, mam);
+
+    std::set<const Function *> Reachable;
+    for (auto *Main : MainFuns)
+        collectReachableFunctions(Main, Reachable);
+    for (auto &Fun : Mod) {
+        if (!Fun.isDeclaration() && Reachable.find(&Fun) == Reachable.end()) {
+            deleteAliasToFun(Mod, &Fun);
+            Fun.deleteBody();
+        }
+    }
+
+    ModulePassManager cleanupMpm(false);
+    cleanupMpm.addPass(GlobalDCEPass {});
+    cleanupMpm.addPass(DeadArgumentEliminationPass {});
+    cleanupMpm.run(Mod, mam);
+}
+
+/// Create a copy of the function sliced w.r.t. the value of the global
+/// variable of the given name. The copy is placed into the module of
+/// the function. If the variable does not exist in the module, the copy is
+/// not sliced.
+/// \return The sliced copy.
+static Function *sliceFunction(Function *Fun, const std::string &VarName) {
+    Module &Mod = *Fun->getParent();
+    std::string Name = (Fun->getName() + ".slice." + VarName).str();
+    ValueToValueMapTy VMap;
+    Function *Slice = CloneFunction(Fun, VMap);
+    Slice->setName(Name);
+
+    if (GlobalVariable *Var = Mod.getGlobalVariable(VarName, true)) {
+        sliceByVariable(Slice, Var);
+        // The slicer may replace the copy by a new function of the same name.
+        Slice = Mod.getFunction(Name);
+    }
+    return Slice;
+}
+
+/// Create sliced copies of the compared functions for each variable of
+/// the variable list. The pairs of the copies form the function list that is
+/// then compared in the batch mode.
+/// The copies are made before the preprocessing (the same as --var slices
+/// the compared functions before the preprocessing), hence the results are
+/// the same as if each variable was compared in a separate run.
+/// \param SlicesFirst Sliced copies in the first module.
+/// \param SlicesSecond Sliced copies in the second module.
+static void sliceFunctions(Config &config,
+                           std::vector<Function *> &SlicesFirst,
+                           std::vector<Function *> &SlicesSecond) {
+    config.FunctionList.clear();
+    if (!config.FirstFun || !config.SecondFun)
+        return;
+
+    for (auto &Var : config.VariableList) {
+        SlicesFirst.push_back(sliceFunction(config.FirstFun, Var));
+        SlicesSecond.push_back(sliceFunction(config.SecondFun, Var));
+        config.FunctionList.push_back((SlicesFirst.back()->getName() + "," +
+                                       SlicesSecond.back()->getName()).str());
+    }
+    DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                    dbgs() << "Sliced compared functions w.r.t. "
+                           << config.VariableList.size() << " variables\n");
+}
+
+/// Run preprocessing of both modules from the configuration.
+/// In the multi-variable mode, the compared functions are first copied and
+/// sliced for each variable and the modules are then preprocessed once for
+/// all the sliced copies.
+static void preprocessModules(Config &config) {
+    PhaseTimer PreprocessingTimer(Phase::Preprocessing);
+    std::vector<Function *> SlicesFirst, SlicesSecond;
+    if (!config.VariableList.empty())
+        sliceFunctions(config, SlicesFirst, SlicesSecond);
+
+    auto Preprocess = [&config](Module &Mod, Function *Main,
+                                GlobalVariable *Var,
+                                const std::vector<Function *> &Slices) {
+        if (!Slices.empty())
+            simplifyReachableFunctions(Mod, Slices, config.ControlFlowOnly,
+                                       config.DropUnreachable);
+        else
+            preprocessModule(Mod, Main, Var, config.ControlFlowOnly,
+                             config.DropUnreachable);
+    };
+
+    if (config.Parallel) {
+        // Each module has its own context and the preprocessing of one module
+        // does not touch the other one, hence the modules can be processed
+        // concurrently.
+        std::thread SecondThread([&]() {
+            Preprocess(*config.Second, config.SecondFun, config.SecondVar,
+                       SlicesSecond);
+        });
+        Preprocess(*config.First, config.FirstFun, config.FirstVar,
+                   SlicesFirst);
+        SecondThread.join();
+    } else {
+        Preprocess(*config.First, config.FirstFun, config.FirstVar,
+                   SlicesFirst);
+        Preprocess(*config.Second, config.SecondFun, config.SecondVar,
+                   SlicesSecond);
+    }
+    config.refreshFunctions();
+}
+
+/// Link definitions of functions missing in one of the programs into its
+/// (original) module. Only functions reported as missing by results that
+/// contain some non-equal functions are linked, other results cannot change.
+/// The index is loaded when it is needed for the first time.
+/// \return True if some definition was linked.
+static bool linkMissingDefinitions(
+        const std::vector<ComparisonResult> &Results, Program Prog,
+        Module &Mod, const std::string &IndexFile,
+        std::unique_ptr<SymbolIndex> &Index) {
+    if (IndexFile.empty())
+        return false;
+
+    std::set<std::string> Missing;
+    for (auto &Result : Results) {
+        if (Result.nonequalFuns.empty())
+            continue;
+        for (auto &Defs : Result.missingDefs) {
+            auto Fun = Prog == Program::First ? Defs.first : Defs.second;
+            if (Fun)
+                Missing.insert(Fun->getName());
+        }
+    }
+    if (Missing.empty())
+        return false;
+
+    if (!Index) {
+        Index = std::unique_ptr<SymbolIndex>(new SymbolIndex());
+        if (!Index->load(IndexFile))
+            errs() << "Cannot load symbol index " << IndexFile << "\n";
+    }
+    return linkDefinitions(Mod, Missing, *Index);
+}
+
+/// Run the complete simplification of the modules from the configuration.
+/// If indices of modules are given, definitions of missing functions are
+/// linked into the compared modules and the simplification is run again as
+/// long as some new definitions are found.
+/// Times of the phases of repeated simplifications are summed up.
+void runSimplification(Config &config) {
+    // Linking must be done into the original modules, hence their copies
+    // must be kept.
+    std::unique_ptr<Module> FirstOrig, SecondOrig;
+    std::unique_ptr<SymbolIndex> FirstIndex, SecondIndex;
+    bool Linking = !config.FirstLinkIndex.empty() ||
+                   !config.SecondLinkIndex.empty();
+    if (Linking) {
+        FirstOrig = CloneModule(config.First.get());
+        SecondOrig = CloneModule(config.Second.get());
+    }
+
+    std::vector<ComparisonResult> Results;
+    while (true) {
+        // Run transformations
+        preprocessModules(config);
+
+        simplifyModulesDiff(config, Results);
+        // Macro indices are only needed during the comparison.
+        clearMacroIndices();
+
+        if (!Linking)
+            break;
+        bool LinkedFirst = linkMissingDefinitions(
+                Results, Program::First, *FirstOrig,
+                config.FirstLinkIndex, FirstIndex);
+        bool LinkedSecond = linkMissingDefinitions(
+                Results, Program::Second, *SecondOrig,
+                config.SecondLinkIndex, SecondIndex);
+        if (!LinkedFirst && !LinkedSecond)
+            break;
+
+        DEBUG_WITH_TYPE(DEBUG_SIMPLL,
+                        dbgs() << "Missing definitions linked, running the "
+                                  "simplification again\n");
+        Results.clear();
+        config.replaceModules(CloneModule(FirstOrig.get()),
+                              CloneModule(SecondOrig.get()));
+    }
+
+    // The report is printed at the end so that the statistics include
+    // postprocessing and writing of the modules.
+    OutputReport Report(config, Results);
+
+    // Collect non-equal functions of all results into two sets.
+    std::set<Function *> MainFunsFirst;
+    std::set<Function *> MainFunsSecond;
+    for (auto &Result : Results) {
+        for (auto &funPair : Result.nonequalFuns) {
+            MainFunsFirst.insert(funPair.first);
+            MainFunsSecond.insert(funPair.second);
+        }
+    }
+
+    // If all functions are equal, only the verdict is needed.
+    if (config.ReportOnly || (config.VerdictOnly && MainFunsFirst.empty() &&
+                              MainFunsSecond.empty())) {
+        Report.print();
+        return;
+    }
+
+    PhaseTimer PostprocessingTimer(Phase::Postprocessing);
+    postprocessModule(*config.First, MainFunsFirst);
+    postprocessModule(*config.Second, MainFunsSecond);
+    PostprocessingTimer.stop();
+
+    // Write LLVM IR to output files
+    PhaseTimer WritingTimer(Phase::Writing);
+    writeIRToFile(*config.First, config.FirstOutFile);
+    writeIRToFile(*config.Second, config.SecondOutFile);
+    WritingTimer.stop();
+
+    Report.print();
 }
@@ -33,25 +33,61 @@ using namespace llvm;
 /// \param Var Global variable w.r.t. to whose value the semantic diff will be
 ///            done. Can be set to NULL, but specifying this enables more
 ///            aggresive simplification.
+/// \param DropUnreachable Delete bodies of functions that are not reachable
+///                        from Main (only used if Main is set).
 void preprocessModule(Module &Mod,
                       Function *Main,
                       GlobalVariable *Var,
-                      bool ControlFlowOnly);
+                      bool ControlFlowOnly,
+                      bool DropUnreachable = false);
+
+/// Results of the comparison of a pair of functions (including the results of
+/// the comparison of all functions called by them).
+struct ComparisonResult {
+    /// Entry of the function list for which the result was computed (empty
+    /// unless the batch mode is used).
+    std::string Name;
+    /// Variable w.r.t. which the compared functions were sliced (empty
+    /// unless the multi-variable mode is used).
+    std::string Variable;
+    /// Compared functions (NULL if all functions of the modules are compared
+    /// or if the function was not found).
+    Function *FirstFun;
+    Function *SecondFun;
+    std::vector<FunPair> nonequalFuns;
+    std::vector<ConstFunPair> missingDefs;
+    std::vector<SyntaxDifference> differingObjects;
+    /// Functions whose comparison did not finish and the reasons why.
+    std::vector<std::pair<FunPair, std::string>> unknownFuns;
+
+    ComparisonResult(Function *FirstFun, Function *SecondFun)
+            : FirstFun(FirstFun), SecondFun(SecondFun) {}
+};
 
 /// Simplify two corresponding modules for the purpose of their subsequent
 /// semantic difference analysis. Tries to remove all the code that is
 /// syntactically equal between the modules which should decrease the complexity
 /// of the semantic diff.
+/// \param config Configuration.
+/// \param Results Results of the comparison. Contains a single result unless
+///                the batch mode is used, in which case there is one result for
+///                each entry of the function list (or for each variable of
+///                the variable list).
 void simplifyModulesDiff(Config &config,
-                         std::vector<FunPair> &nonequalFuns,
-                         std::vector<ConstFunPair> &missingDefs,
-                         std::vector<SyntaxDifference> &differingMacros);
+                         std::vector<ComparisonResult> &Results);
 
-/// Preprocessing transformations - run independently on each module at the
-/// end.
+/// Postprocessing transformations - run independently on each module at the
+/// end. Only the given functions and their callees are kept in the module.
 /// \param Mod Module to simplify.
-/// \param Main Function that is to be compared in the module. Can be set to
-///             NULL, but specifying this optimizes the transformations.
+/// \param MainFuns Functions that were found non-equal in the module.
 void postprocessModule(Module &Mod, const std::set<Function *> &MainFuns);
 
+/// Run the complete simplification of the modules from the configuration.
+/// Both modules are preprocessed and compared, the results are reported to
+/// stdout and the simplified modules are written to the output files. With
+/// the verdict-only option, the modules are not written if all functions are
+/// equal, with the report-only option, they are never written. If statistics
+/// are collected, they are reported together with the results.
+void runSimplification(Config &config);
+
 #endif //DIFFKEMP_SIMPLL_INDEPENDENTPASSES_H
@@ -13,13 +13,17 @@
 
 #include "Utils.h"
 #include "Config.h"
+#include <llvm/IR/GlobalAlias.h>
+#include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Operator.h>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Support/LineIterator.h>
 #include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/Path.h>
 #include <llvm/Support/raw_ostream.h>
+#include <algorithm>
 #include <set>
 #include <iostream>
 #include <llvm/IR/PassManager.h>
@@ -99,60 +103,81 @@ std::string getFileForFun(Function *Fun) {
     return "";
 }
 
-/// Recursive search for call stack from Src to Dest
-bool searchCallStackRec(Function *Src,
-                        Function *Dest,
-                        CallStack &callStack,
-                        std::set<Function *> &visited) {
-    visited.insert(Src);
-    for (auto &BB : *Src) {
-        for (auto &Inst : BB) {
-            // Collect all functions occuring in the instruction.
-            // Function can be either called or used as a parameter
-            std::vector<Function *> calledFuns;
-            if (CallInst *Call = dyn_cast<CallInst>(&Inst)) {
-                if (auto c = Call->getCalledFunction())
-                    calledFuns.push_back(c);
-            }
-            for (auto &Op : Inst.operands()) {
-                if (isa<Function>(Op))
-                    calledFuns.push_back(dyn_cast<Function>(Op));
-            }
+/// Traverse the call graph from the root function in the depth-first order and
+/// record the first call of each function. Functions can be either called or
+/// used as a parameter. Only calls having a debug location are followed.
+CallStackTree::CallStackTree(Function &Root) {
+    // Traversal state of a single function: the instruction whose called
+    // functions are being followed and the next instruction to process.
+    struct Frame {
+        Function *Fun;
+        inst_iterator Next, End;
+        Instruction *Inst = nullptr;
+        std::vector<Function *> Called;
+        unsigned NextCalled = 0;
 
-            // Follow each found function
-            for (Function *called : calledFuns) {
-                if (called && visited.find(called) == visited.end()) {
-                    auto loc = Inst.getDebugLoc();
-                    if (!loc)
-                        continue;
-                    callStack.push_back(CallInfo(called->getName().str(),
-                                                 getFileForFun(Src),
-                                                 loc.getLine()));
-                    if (called == Dest)
-                        return true;
-                    else {
-                        bool found = searchCallStackRec(called, Dest, callStack,
-                                                        visited);
-                        if (found)
-                            return true;
-                        else
-                            callStack.pop_back();
-                    }
-                }
-            }
+        Frame(Function *Fun)
+                : Fun(Fun), Next(inst_begin(Fun)), End(inst_end(Fun)) {}
+    };
+
+    std::set<const Function *> Visited = {&Root};
+    std::vector<Frame> Stack = {Frame(&Root)};
+    while (!Stack.empty()) {
+        Frame &Current = Stack.back();
+        if (Current.NextCalled < Current.Called.size()) {
+            // Follow the next function used in the current instruction
+            Function *Called = Current.Called[Current.NextCalled++];
+            if (!Called || Visited.find(Called) != Visited.end())
+                continue;
+            auto Loc = Current.Inst->getDebugLoc();
+            if (!Loc)
+                continue;
+            Predecessors.insert({Called, {Current.Fun,
+                                          CallInfo(Called->getName().str(),
+                                                   getFileForFun(Current.Fun),
+                                                   Loc.getLine())}});
+            Visited.insert(Called);
+            Stack.emplace_back(Called);
+            continue;
+        }
+        if (Current.Next == Current.End) {
+            Stack.pop_back();
+            continue;
+        }
+
+        // Collect all functions occurring in the next instruction
+        Current.Inst = &*Current.Next++;
+        Current.Called.clear();
+        Current.NextCalled = 0;
+        if (auto Call = dyn_cast<CallInst>(Current.Inst)) {
+            if (auto c = Call->getCalledFunction())
+                Current.Called.push_back(c);
+        }
+        for (auto &Op : Current.Inst->operands()) {
+            if (auto Fun = dyn_cast<Function>(Op))
+                Current.Called.push_back(Fun);
         }
     }
-    return false;
 }
 
-/// Calls the recursive function that retrieves the call stack
-CallStack getCallStack(Function &Src, Function &Dest) {
+/// Get call stack for calling Dest from the root function by following the
+/// recorded callers from Dest back to the root.
+CallStack CallStackTree::getCallStack(const Function &Dest) const {
     CallStack callStack;
-    std::set<Function *> visited;
-    searchCallStackRec(&Src, &Dest, callStack, visited);
+    auto Pred = Predecessors.find(&Dest);
+    while (Pred != Predecessors.end()) {
+        callStack.push_back(Pred->second.second);
+        Pred = Predecessors.find(Pred->second.first);
+    }
+    std::reverse(callStack.begin(), callStack.end());
     return callStack;
 }
 
+/// Get call stack for calling Dest from Src.
+CallStack getCallStack(Function &Src, Function &Dest) {
+    return CallStackTree(Src).getCallStack(Dest);
+}
+
 /// Check if function has side effect (has 'store' instruction or calls some
 /// other function with side effect).
 bool hasSideEffect(const Function &Fun, std::set<const Function *> &Visited) {
@@ -186,6 +211,33 @@ bool hasSideEffect(const Function &Fun) {
     return hasSideEffect(Fun, visited);
 }
 
+/// Check if a function has indirect call (call to a value).
+bool hasIndirectCall(const Function &Fun) {
+    for (auto &BB : Fun) {
+        for (auto &Inst : BB) {
+            if (auto Call = dyn_cast<CallInst>(&Inst)) {
+                if (Call->getCalledFunction())
+                    continue;
+                // For indirect call, check if the called value is ever used
+                // (apart from debug instructions and the call itself).
+                // If not, do not return true.
+                const Value *called = Call->getCalledValue();
+                for (auto &Use : called->uses()) {
+                    if (Use.getUser() == Call)
+                        continue;
+                    if (auto UserCall = dyn_cast<CallInst>(Use.getUser())) {
+                        if (UserCall->getCalledFunction()
+                                && UserCall->getCalledFunction()->isIntrinsic())
+                            continue;
+                    }
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
 /// Returns true if the function is one of the supported allocators
 bool isAllocFunction(const Function &Fun) {
     return Fun.getName() == "kzalloc" || Fun.getName() == "__kmalloc" ||
@@ -312,3 +364,38 @@ void findAndReplace(std::string &input, std::string find,
         position += replace.length();
     }
 }
+
+/// Write LLVM IR of a module into a file.
+/// \param Mod LLVM module to write.
+/// \param FileName Path to the file to write to.
+void writeIRToFile(Module &Mod, StringRef FileName) {
+    std::error_code errorCode;
+    raw_fd_ostream stream(FileName, errorCode, sys::fs::F_None);
+    Mod.print(stream, nullptr);
+    stream.close();
+}
+
+/// Add all functions that the value refers to into the list. Besides
+/// functions themselves, aliases of functions and functions used inside
+/// constant expressions are considered.
+/// \param Val Value to search functions in.
+/// \param Visited Already visited constants (each is searched only once).
+/// \param Functions List to add the found functions to.
+void collectReferencedFunctions(const Value *Val,
+                                std::set<const Constant *> &Visited,
+                                std::vector<const Function *> &Functions) {
+    if (auto Fun = dyn_cast<Function>(Val)) {
+        Functions.push_back(Fun);
+    } else if (auto Alias = dyn_cast<GlobalAlias>(Val)) {
+        if (Visited.insert(Alias).second)
+            collectReferencedFunctions(Alias->getAliasee(), Visited,
+                                       Functions);
+    } else if (isa<GlobalValue>(Val)) {
+        return;
+    } else if (auto Const = dyn_cast<Constant>(Val)) {
+        if (!Visited.insert(Const).second)
+            return;
+        for (auto &Op : Const->operands())
+            collectReferencedFunctions(Op.get(), Visited, Functions);
+    }
+}
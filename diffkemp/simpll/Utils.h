@@ -14,8 +14,10 @@
 #ifndef DIFFKEMP_SIMPLL_UTILS_H
 #define DIFFKEMP_SIMPLL_UTILS_H
 
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/Function.h>
+#include <set>
 #include <unordered_map>
 
 using namespace llvm;
@@ -65,9 +67,32 @@ std::string getFileForFun(Function *Fun);
 /// Get call stack for calling Dest from Src
 CallStack getCallStack(Function &Src, Function &Dest);
 
+/// Call stacks for calling all functions reachable from a root function.
+/// The call graph is traversed only once (in the same order as a single call
+/// of getCallStack traverses it) and the first call of each function is
+/// recorded. Each call stack is then reconstructed in time linear to its
+/// length.
+class CallStackTree {
+  public:
+    CallStackTree(Function &Root);
+
+    /// Get call stack for calling Dest from the root function.
+    /// \return Empty call stack if Dest is not reachable from the root.
+    CallStack getCallStack(const Function &Dest) const;
+
+  private:
+    /// For each reached function, the function that calls it and the call
+    /// entry of the call.
+    DenseMap<const Function *, std::pair<const Function *, CallInfo>>
+            Predecessors;
+};
+
 /// Check if function has side-effect.
 bool hasSideEffect(const Function &Fun);
 
+/// Check if a function has indirect call (call to a value).
+bool hasIndirectCall(const Function &Fun);
+
 /// Check if the function is an allocator
 bool isAllocFunction(const Function &Fun);
 
@@ -104,4 +129,14 @@ bool isValidCharForIdentifierStart(char ch);
 void findAndReplace(std::string &input, std::string find,
         std::string replace);
 
+/// Write LLVM IR of a module into a file.
+void writeIRToFile(Module &Mod, StringRef FileName);
+
+/// Add all functions that the value refers to into the list. Besides
+/// functions themselves, aliases of functions and functions used inside
+/// constant expressions are considered.
+void collectReferencedFunctions(const Value *Val,
+                                std::set<const Constant *> &Visited,
+                                std::vector<const Function *> &Functions);
+
 #endif //DIFFKEMP_SIMPLL_UTILS_H
@@ -23,7 +23,14 @@ CalledFunctionsAnalysis::Result CalledFunctionsAnalysis::run(
         AnalysisManager<Module, Function *> &mam,
         Function *Main) {
     Result result;
-    collectCalled(Main, result);
+    if (Main)
+        collectCalled(Main, result);
+    else {
+        // No main function is given, all functions of the module are
+        // potentially called.
+        for (auto &Fun : Mod)
+            collectCalled(&Fun, result);
+    }
     return result;
 }
 
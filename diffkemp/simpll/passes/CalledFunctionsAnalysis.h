@@ -20,6 +20,9 @@
 
 using namespace llvm;
 
+/// Analysis collecting all functions that are (transitively) called by the
+/// main function. If no main function is given (Main is NULL), all functions
+/// of the module are collected.
 class CalledFunctionsAnalysis
         : public AnalysisInfoMixin<CalledFunctionsAnalysis> {
   public:
@@ -14,6 +14,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "ControlFlowSlicer.h"
+#include "SideEffectSummaryAnalysis.h"
 #include "Utils.h"
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Instructions.h>
@@ -43,33 +44,6 @@ void addWithUsers(const Instruction &Instr,
     }
 }
 
-/// Check if a function has indirect call (call to a value).
-bool hasIndirectCall(const Function &Fun) {
-    for (auto &BB : Fun) {
-        for (auto &Inst : BB) {
-            if (auto Call = dyn_cast<CallInst>(&Inst)) {
-                if (Call->getCalledFunction())
-                    continue;
-                // For indirect call, check if the called value is ever used
-                // (apart from debug instructions and the call itself).
-                // If not, do not return true.
-                const Value *called = Call->getCalledValue();
-                for (auto &Use : called->uses()) {
-                    if (Use.getUser() == Call)
-                        continue;
-                    if (auto UserCall = dyn_cast<CallInst>(Use.getUser())) {
-                        if (UserCall->getCalledFunction()
-                                && UserCall->getCalledFunction()->isIntrinsic())
-                            continue;
-                    }
-                    return true;
-                }
-            }
-        }
-    }
-    return false;
-}
-
 /// Check if all uses of a function are stores.
 bool isResultOnlyStored(const Instruction *Inst) {
     for (const auto &User : Inst->users()) {
@@ -82,8 +56,18 @@ bool isResultOnlyStored(const Instruction *Inst) {
 
 /// Keep only function calls, branches, instructions having functions as
 /// parameters, and all instructions depending on these.
+/// Side effects of the called functions are taken from the summary of
+/// the module if it has been computed.
 PreservedAnalyses ControlFlowSlicer::run(Function &Fun,
                                          FunctionAnalysisManager &fam) {
+    auto &MAMProxy = fam.getResult<ModuleAnalysisManagerFunctionProxy>(Fun);
+    auto *Summary = MAMProxy.getCachedResult<SideEffectSummaryAnalysis>(
+            *Fun.getParent());
+    // Instructions are removed only after all of them are visited, hence it
+    // is sufficient to look for indirect calls in Fun once.
+    bool IndirectCall = Summary ? Summary->hasIndirectCall(Fun)
+                                : hasIndirectCall(Fun);
+
     std::set<const Instruction *> Dependent;
     for (const auto &BB : Fun) {
         for (const auto &Instr : BB) {
@@ -96,7 +80,9 @@ PreservedAnalyses ControlFlowSlicer::run(Function &Fun,
                 // Call instruction except calls to intrinsics
                 keep = true;
                 auto Function = CallInstr->getCalledFunction();
-                if (Function && !hasSideEffect(*Function) &&
+                if (Function &&
+                        !(Summary ? Summary->hasSideEffect(*Function)
+                                  : hasSideEffect(*Function)) &&
                         isResultOnlyStored(CallInstr)) {
                     // Remove calls to functions having no side effects whose
                     // result is only stored somewhere (does not affect control
@@ -115,7 +101,7 @@ PreservedAnalyses ControlFlowSlicer::run(Function &Fun,
                 // if it is possible that the functions is sometimes called.
                 // This at least requires that Fun contains an indirect call.
                 for (auto &Op : Instr.operands()) {
-                    if (isa<Function>(Op) && hasIndirectCall(Fun)) {
+                    if (isa<Function>(Op) && IndirectCall) {
                         keep = true;
                         break;
                     }
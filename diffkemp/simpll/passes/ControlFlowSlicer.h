@@ -20,6 +20,9 @@
 
 using namespace llvm;
 
+/// The pass requires ModuleAnalysisManagerFunctionProxy to be registered.
+/// If SideEffectSummaryAnalysis of the module is cached, it is used to decide
+/// whether the called functions have side effects.
 class ControlFlowSlicer : public PassInfoMixin<ControlFlowSlicer> {
   public:
     PreservedAnalyses run(Function &Fun, FunctionAnalysisManager &fam);
@@ -0,0 +1,112 @@
+//===-- SideEffectSummaryAnalysis.cpp - Summaries of function side effects ===//
+//
+//       SimpLL - Program simplifier for analysis of semantic difference      //
+//
+// This file is published under Apache 2.0 license. See LICENSE for details.
+// Author: Viktor Malik, vmalik@redhat.com
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the implementation of the SideEffectSummaryAnalysis pass
+/// that summarizes side effects and indirect calls of all functions of
+/// a module.
+///
+//===----------------------------------------------------------------------===//
+
+#include "SideEffectSummaryAnalysis.h"
+#include "Utils.h"
+#include <llvm/ADT/SCCIterator.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/IR/Instructions.h>
+
+AnalysisKey SideEffectSummaryAnalysis::Key;
+
+/// Summarize all defined functions of the module.
+/// SCCs of the call graph are visited bottom-up starting from the external
+/// calling node, which covers all functions that are visible outside of
+/// the module or whose address is taken. Functions not reached this way are
+/// then used as additional roots.
+SideEffectSummaryAnalysis::Result SideEffectSummaryAnalysis::run(
+        Module &Mod, ModuleAnalysisManager &mam) {
+    Result result;
+    CallGraph CG(Mod);
+    for (auto SCC = scc_begin(&CG); !SCC.isAtEnd(); ++SCC)
+        result.summarizeSCC(*SCC);
+    for (auto &Fun : Mod) {
+        if (Fun.isDeclaration() ||
+                result.Summaries.find(&Fun) != result.Summaries.end())
+            continue;
+        for (auto SCC = scc_begin(CG[&Fun]); !SCC.isAtEnd(); ++SCC)
+            result.summarizeSCC(*SCC);
+    }
+    return result;
+}
+
+/// Summarize functions of a single SCC of the call graph.
+/// Functions called from the SCC that lie outside of it are already summarized
+/// since SCCs are visited bottom-up. All functions of the SCC have a side
+/// effect if any of them stores to memory, contains an indirect call, or calls
+/// a function outside of the SCC having a side effect. Calls between functions
+/// of the SCC do not add a side effect by themselves (the same as in
+/// the recursive hasSideEffect).
+void SideEffectSummaryAnalysis::Result::summarizeSCC(
+        const std::vector<CallGraphNode *> &SCC) {
+    SmallPtrSet<const Function *, 8> Members;
+    for (auto *Node : SCC) {
+        auto *Fun = Node->getFunction();
+        if (Fun && !Fun->isDeclaration())
+            Members.insert(Fun);
+    }
+    // SCCs reached again from an additional root are already summarized.
+    if (Members.empty() ||
+            Summaries.find(*Members.begin()) != Summaries.end())
+        return;
+
+    bool SideEffect = false;
+    for (auto *Fun : Members) {
+        for (auto &BB : *Fun) {
+            for (auto &Inst : BB) {
+                if (isa<StoreInst>(&Inst))
+                    SideEffect = true;
+                else if (auto Call = dyn_cast<CallInst>(&Inst)) {
+                    const Function *Called = Call->getCalledFunction();
+                    if (!Called)
+                        SideEffect = true;
+                    else if (Members.count(Called) == 0 &&
+                            hasSideEffect(*Called))
+                        SideEffect = true;
+                }
+                if (SideEffect)
+                    break;
+            }
+            if (SideEffect)
+                break;
+        }
+        if (SideEffect)
+            break;
+    }
+
+    for (auto *Fun : Members)
+        Summaries[Fun] = {SideEffect, ::hasIndirectCall(*Fun)};
+}
+
+/// Check if the function has a side effect. Declarations are not summarized,
+/// their side effects are given by their intrinsic IDs only.
+bool SideEffectSummaryAnalysis::Result::hasSideEffect(
+        const Function &Fun) const {
+    if (!Fun.isDeclaration()) {
+        auto Summary = Summaries.find(&Fun);
+        if (Summary != Summaries.end())
+            return Summary->second.SideEffect;
+    }
+    return ::hasSideEffect(Fun);
+}
+
+/// Check if the function contains an indirect call.
+bool SideEffectSummaryAnalysis::Result::hasIndirectCall(
+        const Function &Fun) const {
+    auto Summary = Summaries.find(&Fun);
+    if (Summary != Summaries.end())
+        return Summary->second.IndirectCall;
+    return ::hasIndirectCall(Fun);
+}
@@ -0,0 +1,66 @@
+//===--- SideEffectSummaryAnalysis.h - Summaries of function side effects -===//
+//
+//       SimpLL - Program simplifier for analysis of semantic difference      //
+//
+// This file is published under Apache 2.0 license. See LICENSE for details.
+// Author: Viktor Malik, vmalik@redhat.com
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the declaration of the SideEffectSummaryAnalysis pass
+/// that summarizes side effects and indirect calls of all functions of
+/// a module.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef DIFFKEMP_SIMPLL_SIDEEFFECTSUMMARYANALYSIS_H
+#define DIFFKEMP_SIMPLL_SIDEEFFECTSUMMARYANALYSIS_H
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Analysis/CallGraph.h>
+#include <llvm/IR/PassManager.h>
+#include <vector>
+
+using namespace llvm;
+
+/// Analysis summarizing for each function of the module whether it has a side
+/// effect and whether it contains an indirect call (with the same meaning as
+/// hasSideEffect and hasIndirectCall from Utils have).
+/// The summaries are computed once, bottom-up over the SCCs of the call graph,
+/// hence each query takes a constant time. Function passes can get the result
+/// through the ModuleAnalysisManagerFunctionProxy.
+class SideEffectSummaryAnalysis
+        : public AnalysisInfoMixin<SideEffectSummaryAnalysis> {
+  public:
+    class Result {
+      public:
+        /// Check if the function has a side effect.
+        bool hasSideEffect(const Function &Fun) const;
+        /// Check if the function contains an indirect call.
+        bool hasIndirectCall(const Function &Fun) const;
+
+      private:
+        friend class SideEffectSummaryAnalysis;
+
+        struct FunctionSummary {
+            bool SideEffect;
+            bool IndirectCall;
+        };
+        /// Summaries of the defined functions. Functions that were created
+        /// after the analysis was run are not summarized, queries on them
+        /// compute the property directly.
+        DenseMap<const Function *, FunctionSummary> Summaries;
+
+        /// Summarize functions of a single SCC of the call graph.
+        void summarizeSCC(const std::vector<CallGraphNode *> &SCC);
+    };
+
+    /// Summarize all defined functions of the module.
+    Result run(Module &Mod, ModuleAnalysisManager &mam);
+
+  private:
+    friend AnalysisInfoMixin<SideEffectSummaryAnalysis>;
+    static AnalysisKey Key;
+};
+
+#endif //DIFFKEMP_SIMPLL_SIDEEFFECTSUMMARYANALYSIS_H
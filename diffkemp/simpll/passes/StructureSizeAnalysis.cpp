@@ -13,30 +13,53 @@
 
 #include "StructureSizeAnalysis.h"
 #include "llvm/IR/TypeFinder.h"
+#include <algorithm>
 
 AnalysisKey StructureSizeAnalysis::Key;
 
 StructureSizeAnalysis::Result StructureSizeAnalysis::run(Module &Mod,
         AnalysisManager<Module, Function *> &mam, Function *Main) {
+    return Result(Mod);
+}
+
+/// Get sorted names of all structure types having the given size. The index
+/// is built on the first query.
+const std::vector<StringRef> *StructureSizeAnalysis::Result::lookup(
+        uint64_t Size) const {
+    // These values are reserved by DenseMap, no type can have such size.
+    if (Size == DenseMapInfo<uint64_t>::getEmptyKey() ||
+            Size == DenseMapInfo<uint64_t>::getTombstoneKey())
+        return nullptr;
+
+    if (!Built)
+        build();
+    auto Names = Index.find(Size);
+    if (Names == Index.end())
+        return nullptr;
+    return &Names->second;
+}
+
+/// Collect all sized structure types of the module and index their names by
+/// the type sizes. Names in each entry are sorted so that the entries can be
+/// directly compared between modules.
+void StructureSizeAnalysis::Result::build() const {
     TypeFinder Types;
-    Result Res;
-    Types.run(Mod, true);
+    Types.run(*Mod, true);
 
     for (auto *Ty : Types) {
         if (StructType *STy = dyn_cast<StructType>(Ty)) {
             if (!STy->isSized())
                 continue;
-            uint64_t STySize = Mod.getDataLayout().getTypeAllocSize(STy);
-            auto Elem = Res.find(STySize);
-            if (Elem != Res.end()) {
-                Elem->second.insert(STy->getStructName());
-            } else {
-                std::set<std::string> Set;
-                Set.insert(STy->getStructName());
-                Res[STySize] = Set;
-            }
+            uint64_t STySize = Mod->getDataLayout().getTypeAllocSize(STy);
+            Index[STySize].push_back(
+                    Names.insert(STy->getStructName()).first->getKey());
         }
     }
-
-    return Res;
+    for (auto &Entry : Index) {
+        auto &EntryNames = Entry.second;
+        std::sort(EntryNames.begin(), EntryNames.end());
+        EntryNames.erase(std::unique(EntryNames.begin(), EntryNames.end()),
+                         EntryNames.end());
+    }
+    Built = true;
 }
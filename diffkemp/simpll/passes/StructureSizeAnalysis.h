@@ -14,19 +14,41 @@
 #ifndef DIFFKEMP_SIMPLL_STRUCTURESIZEANALYSIS_H
 #define DIFFKEMP_SIMPLL_STRUCTURESIZEANALYSIS_H
 
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringSet.h>
 #include <llvm/IR/PassManager.h>
-#include <set>
-#include <map>
+#include <vector>
 
 using namespace llvm;
 
 class StructureSizeAnalysis
         : public AnalysisInfoMixin<StructureSizeAnalysis> {
   public:
-    using Result = std::map<int, std::set<std::string>>;
+    /// Index of sized structure types of a module by their allocation sizes.
+    /// The index is only built when it is queried for the first time, so
+    /// modules whose comparison never needs it do not pay for collecting all
+    /// their types.
+    class Result {
+      public:
+        Result(const Module &Mod) : Mod(&Mod) {}
 
-    /// Collects all structure type sizes and creates a map from the size
-    /// numbers to a set of structure names.
+        /// Get sorted names of all structure types having the given size.
+        /// \return Null if there is no structure type of the given size.
+        const std::vector<StringRef> *lookup(uint64_t Size) const;
+
+      private:
+        const Module *Mod;
+        mutable bool Built = false;
+        /// Interned names of the indexed types
+        mutable StringSet<> Names;
+        /// Names of structure types indexed by the type sizes
+        mutable DenseMap<uint64_t, std::vector<StringRef>> Index;
+
+        /// Collect all sized structure types of the module.
+        void build() const;
+    };
+
+    /// Creates an index of structure type sizes (built lazily).
     Result run(Module &Mod,
                AnalysisManager<Module, Function *> &mam,
                Function *Main);
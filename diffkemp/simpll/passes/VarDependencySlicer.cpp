@@ -15,7 +15,7 @@
 #include "VarDependencySlicer.h"
 #include <Config.h>
 #include "DebugInfo.h"
-#include <llvm/Analysis/CFG.h>
+#include <llvm/ADT/DepthFirstIterator.h>
 #include <llvm/IR/CFG.h>
 #include <llvm/IR/Operator.h>
 #include <llvm/Transforms/Utils/BasicBlockUtils.h>
@@ -23,6 +23,23 @@
 #include <llvm/Transforms/Utils/UnifyFunctionExitNodes.h>
 #include <llvm/Transforms/Utils/Cloning.h>
 
+/// Maximal number of blocks visited by llvm::isPotentiallyReachable (when
+/// no dominator tree and loop info are given). If more blocks are reachable,
+/// it conservatively answers that the destination is reachable.
+static const unsigned ReachabilitySearchLimit = 32;
+
+/// Add a number to a set of numbers represented by a bit vector.
+static void insertNumber(BitVector &Set, unsigned Number) {
+    if (Number >= Set.size())
+        Set.resize(Number + 1);
+    Set.set(Number);
+}
+
+/// Check if a set of numbers represented by a bit vector contains a number.
+static bool containsNumber(const BitVector &Set, unsigned Number) {
+    return Number < Set.size() && Set.test(Number);
+}
+
 PreservedAnalyses VarDependencySlicer::run(Function &Fun,
                                            FunctionAnalysisManager &fam,
                                            GlobalVariable *Var) {
@@ -30,12 +47,22 @@ PreservedAnalyses VarDependencySlicer::run(Function &Fun,
         return PreservedAnalyses::all();
 
     Variable = Var;
-    // Clear all sets
-    DependentInstrs.clear();
-    IncludedInstrs.clear();
-    AffectedBasicBlocks.clear();
-    IncludedBasicBlocks.clear();
-    IncludedParams.clear();
+    // Number all instructions and basic blocks and clear all sets
+    InstrNumbers.clear();
+    Instrs.clear();
+    BlockNumbers.clear();
+    Blocks.clear();
+    for (auto &BB : Fun) {
+        getNumber(&BB);
+        for (auto &Instr : BB)
+            getNumber(&Instr);
+    }
+    DependentInstrs = BitVector(Instrs.size());
+    IncludedInstrs = BitVector(Instrs.size());
+    AffectedBasicBlocks = BitVector(Blocks.size());
+    IncludedBasicBlocks = BitVector(Blocks.size());
+    IncludedParams = BitVector(Fun.arg_size());
+    ReachableFrom.clear();
 
     DEBUG_WITH_TYPE(DEBUG_SIMPLL,
                     dbgs() << "Function: " << Fun.getName().str() << "\n");
@@ -87,15 +114,17 @@ PreservedAnalyses VarDependencySlicer::run(Function &Fun,
     // produce a valid CFG
     DEBUG_WITH_TYPE(DEBUG_SIMPLL, dbgs() << "Second phase\n");
     // Recursively add all instruction operands to included
-    for (auto &Inst : DependentInstrs) {
-        if (isa<PHINode>(Inst))
+    for (int i = DependentInstrs.find_first(); i != -1;
+         i = DependentInstrs.find_next(i)) {
+        if (isa<PHINode>(Instrs[i]))
             continue;
-        addAllOpsToIncluded(Inst);
+        addAllOpsToIncluded(Instrs[i]);
     }
 
     UnifyFunctionExitNodes unifyExitPass;
     unifyExitPass.runOnFunction(Fun);
     RetBB = unifyExitPass.getReturnBlock();
+    ReachableFrom.clear();
 
     for (auto &BB : Fun) {
         auto Term = BB.getTerminator();
@@ -118,13 +147,14 @@ PreservedAnalyses VarDependencySlicer::run(Function &Fun,
             // Create and insert new branch
             auto NewTerm = BranchInst::Create(NewSucc, Term);
             Term->eraseFromParent();
-            IncludedInstrs.insert(NewTerm);
+            insertNumber(IncludedInstrs, getNumber(NewTerm));
+            ReachableFrom.clear();
         } else {
             addToIncluded(Term);
             addAllOpsToIncluded(Term);
         }
     }
-    IncludedInstrs.insert(DependentInstrs.begin(), DependentInstrs.end());
+    IncludedInstrs |= DependentInstrs;
 
     // Add needed instructions coming to Phis to included
     for (auto &BB : Fun) {
@@ -231,30 +261,31 @@ PreservedAnalyses VarDependencySlicer::run(Function &Fun,
 /// blocks reachable from individual branches.
 std::vector<const BasicBlock *> VarDependencySlicer::affectedBasicBlocks(
         BranchInst *Branch) {
-    std::set<const BasicBlock *> reachableUnion;
-    std::set<const BasicBlock *> reachableIntersection;
+    BitVector reachableUnion;
+    BitVector reachableIntersection;
     bool first = true;
     if (Branch->isConditional()) {
         for (auto Succ : Branch->successors()) {
             auto reachable = reachableBlocksThroughSucc(Branch, Succ);
 
             // Compute union with blocks reachable from other branches
-            uniteWith(reachableUnion, reachable);
+            reachableUnion |= reachable;
 
             // Compute intersection with blocks reachable from other branches
             if (first) {
                 reachableIntersection = std::move(reachable);
                 first = false;
             } else {
-                intersectWith(reachableIntersection, reachable);
+                reachableIntersection &= reachable;
             }
         }
     }
+    reachableUnion.reset(reachableIntersection);
+
     std::vector<const BasicBlock *> result;
-    std::set_difference(reachableUnion.begin(), reachableUnion.end(),
-                        reachableIntersection.begin(),
-                        reachableIntersection.end(),
-                        std::back_inserter(result));
+    for (int i = reachableUnion.find_first(); i != -1;
+         i = reachableUnion.find_next(i))
+        result.push_back(Blocks[i]);
     return result;
 }
 
@@ -262,10 +293,10 @@ std::vector<const BasicBlock *> VarDependencySlicer::affectedBasicBlocks(
 void VarDependencySlicer::addAllInstrs(
         const std::vector<const BasicBlock *> BBs) {
     for (auto BB : BBs) {
-        AffectedBasicBlocks.insert(BB);
-        IncludedBasicBlocks.insert(BB);
+        insertNumber(AffectedBasicBlocks, getNumber(BB));
+        insertNumber(IncludedBasicBlocks, getNumber(BB));
         for (auto &Instr : *BB) {
-            DependentInstrs.insert(&Instr);
+            insertNumber(DependentInstrs, getNumber(&Instr));
             DEBUG_WITH_TYPE(DEBUG_SIMPLL, {
                 dbgs() << "Dependent: ";
                 Instr.print(dbgs());
@@ -307,41 +338,46 @@ bool VarDependencySlicer::addToIncluded(const Instruction *Inst) {
 }
 
 /// Add instruction to the given set of instructions.
-bool VarDependencySlicer::addToSet(const Instruction *Inst,
-                                   std::set<const Instruction *> &set) {
-
-    bool added = false;
-    auto add = set.insert(Inst);
-    if (add.second) {
-        added = true;
-        IncludedBasicBlocks.insert(Inst->getParent());
-    }
-    return added;
+bool VarDependencySlicer::addToSet(const Instruction *Inst, BitVector &set) {
+    unsigned Number = getNumber(Inst);
+    if (containsNumber(set, Number))
+        return false;
+    insertNumber(set, Number);
+    insertNumber(IncludedBasicBlocks, getNumber(Inst->getParent()));
+    return true;
 }
 
-/// Recursively add all operands of an instruction to included instructions.
+/// Add all operands of an instruction to included instructions. This is done
+/// transitively (operands of the newly included instructions are included,
+/// too) using a worklist.
 /// \param Inst
-/// \return
+/// \return True if some operand of Inst was newly included.
 bool VarDependencySlicer::addAllOpsToIncluded(
         const Instruction *Inst) {
     bool added = false;
-    for (auto &Op : Inst->operands()) {
-        if (auto OpInst = dyn_cast<Instruction>(&Op)) {
-            if (addToIncluded(OpInst)) {
-                DEBUG_WITH_TYPE(DEBUG_SIMPLL, {
-                    dbgs() << "Included: ";
-                    OpInst->print(dbgs());
-                });
-                added = true;
-                addAllOpsToIncluded(OpInst);
+    std::vector<const Instruction *> Worklist = {Inst};
+    while (!Worklist.empty()) {
+        const Instruction *Current = Worklist.back();
+        Worklist.pop_back();
+        for (auto &Op : Current->operands()) {
+            if (auto OpInst = dyn_cast<Instruction>(&Op)) {
+                if (addToIncluded(OpInst)) {
+                    DEBUG_WITH_TYPE(DEBUG_SIMPLL, {
+                        dbgs() << "Included: ";
+                        OpInst->print(dbgs());
+                    });
+                    if (Current == Inst)
+                        added = true;
+                    Worklist.push_back(OpInst);
+                }
+                if (isa<AllocaInst>(OpInst))
+                    // For alloca, add all stores between the alloca and
+                    // the current instruction to included.
+                    addStoresToIncluded(OpInst, Current, Worklist);
             }
-            if (isa<AllocaInst>(OpInst))
-                // For alloca, add all stores between the alloca and
-                // the current instruction to included.
-                addStoresToIncluded(OpInst, Inst);
+            if (auto OpParam = dyn_cast<Argument>(Op))
+                insertNumber(IncludedParams, OpParam->getArgNo());
         }
-        if (auto OpParam = dyn_cast<Argument>(Op))
-            IncludedParams.insert(OpParam);
     }
     return added;
 }
@@ -365,24 +401,22 @@ std::set<BasicBlock *> VarDependencySlicer::includedSuccessors(
     // Find all included blocks (except exit block) that are reachable through
     // true edge
     auto reachableTrue = reachableBlocksThroughSucc(&Terminator, TrueSucc);
-    intersectWith(reachableTrue, IncludedBasicBlocks);
+    reachableTrue &= IncludedBasicBlocks;
     if (ExitBlock)
-        reachableTrue.erase(ExitBlock);
+        reachableTrue.reset(getNumber(ExitBlock));
     // Find all included blocks (except exit block) that are reachable through
     // false edge
     auto reachableFalse = reachableBlocksThroughSucc(&Terminator, FalseSucc);
-    intersectWith(reachableFalse, IncludedBasicBlocks);
+    reachableFalse &= IncludedBasicBlocks;
     if (ExitBlock)
-        reachableFalse.erase(ExitBlock);
+        reachableFalse.reset(getNumber(ExitBlock));
 
     if (reachableTrue != reachableFalse) {
         // If one successor covers all included blocks reachable from the other
         // successor, choose it
-        if (std::includes(reachableTrue.begin(), reachableTrue.end(),
-                          reachableFalse.begin(), reachableFalse.end()))
+        if (!reachableFalse.test(reachableTrue))
             return {TrueSucc};
-        if (std::includes(reachableFalse.begin(), reachableFalse.end(),
-                          reachableTrue.begin(), reachableTrue.end()))
+        if (!reachableTrue.test(reachableFalse))
             return {FalseSucc};
         // If neither of successors covers all blocks reachable by the other,
         // we have to follow both
@@ -394,11 +428,11 @@ std::set<BasicBlock *> VarDependencySlicer::includedSuccessors(
     // One of them might reach other blocks through loop only and than we need
     // to keep the other one
     // TODO this should use loop analysis
-    if (!reachableTrue.empty()) {
-        if (!isPotentiallyReachable(TrueSucc, Terminator.getParent())) {
+    if (reachableTrue.any()) {
+        if (!potentiallyReachable(TrueSucc, Terminator.getParent())) {
             return {TrueSucc};
-        } else if (!isPotentiallyReachable(FalseSucc,
-                                           Terminator.getParent())) {
+        } else if (!potentiallyReachable(FalseSucc,
+                                         Terminator.getParent())) {
             return {FalseSucc};
         } else {
             return {TrueSucc == ExitBlock ? FalseSucc : TrueSucc};
@@ -446,78 +480,112 @@ bool VarDependencySlicer::canRemoveFirstBlock(const BasicBlock *bb) {
 }
 
 /// Calculate the set of all basic blocks reachable from some block in
-/// a function.
-std::set<const BasicBlock *> VarDependencySlicer::reachableBlocks(
-        const BasicBlock *Src, Function &Fun) {
-    std::set<const BasicBlock *> result;
-    for (auto &BB : Fun) {
-        if (Src != &BB && isPotentiallyReachable(Src, &BB))
-            result.insert(&BB);
+/// a function (including the block itself). If Sink is given, successors of
+/// Sink are not followed.
+BitVector VarDependencySlicer::reachableBlocks(const BasicBlock *Src,
+                                               const BasicBlock *Sink) {
+    for (auto &BB : *Src->getParent())
+        getNumber(&BB);
+
+    BitVector result(Blocks.size());
+    std::vector<const BasicBlock *> worklist = {Src};
+    result.set(getNumber(Src));
+    while (!worklist.empty()) {
+        const BasicBlock *BB = worklist.back();
+        worklist.pop_back();
+        if (BB == Sink)
+            continue;
+        for (auto Succ : successors(BB)) {
+            unsigned SuccNumber = getNumber(Succ);
+            if (!result.test(SuccNumber)) {
+                result.set(SuccNumber);
+                worklist.push_back(Succ);
+            }
+        }
     }
     return result;
 }
 
 /// Calculate a set of all basic blocks that are reachable via a successor of
-/// a terminator instruction.
-std::set<const BasicBlock *> VarDependencySlicer::reachableBlocksThroughSucc(
+/// a terminator instruction (the block of the terminator is not included).
+/// The result is the same as if the terminator was replaced by an
+/// unconditional branch to the successor and llvm::isPotentiallyReachable was
+/// used to check reachability of each block of the function. Hence, if at
+/// least ReachabilitySearchLimit blocks are reachable, all blocks are
+/// considered to be reachable.
+BitVector VarDependencySlicer::reachableBlocksThroughSucc(
         TerminatorInst *Terminator, BasicBlock *Succ) {
-    // Replace terminator by unconditional branch and find all blocks reachable
-    // through the new branch (one that omits all other successors)
-    auto NewBranch = BranchInst::Create(Succ, Terminator);
-    Terminator->removeFromParent();
-    auto reachable = reachableBlocks(NewBranch->getParent(),
-                                     *Succ->getParent());
-
-    // Restore original terminator
-    Terminator->insertBefore(NewBranch);
-    NewBranch->eraseFromParent();
-
+    // Blocks reachable from the successor, not going through the terminator
+    // block again (the only successor of the block would be Succ).
+    const BasicBlock *Src = Terminator->getParent();
+    auto reachable = reachableBlocks(Succ, Src);
+    reachable.set(getNumber(Src));
+
+    if (reachable.count() >= ReachabilitySearchLimit) {
+        reachable.reset();
+        for (auto &BB : *Src->getParent())
+            reachable.set(getNumber(&BB));
+    }
+    reachable.reset(getNumber(Src));
     return reachable;
 }
 
-/// Set intersection. Result is stored in the first set.
-void VarDependencySlicer::intersectWith(
-        std::set<const BasicBlock *> &set,
-        const std::set<const BasicBlock *> &other) {
-    std::set<const BasicBlock *> tmpSet;
-    std::set_intersection(set.begin(), set.end(), other.begin(), other.end(),
-                          std::inserter(tmpSet, tmpSet.begin()));
-    set = std::move(tmpSet);
+/// Check if the block To is potentially reachable from the block From. Gives
+/// the same answer as llvm::isPotentiallyReachable without dominator tree and
+/// loop info, i.e. it answers true if at least ReachabilitySearchLimit blocks
+/// are reachable from From. Sets of reachable blocks are cached until
+/// the CFG changes.
+bool VarDependencySlicer::potentiallyReachable(const BasicBlock *From,
+                                               const BasicBlock *To) {
+    auto Cached = ReachableFrom.find(From);
+    if (Cached == ReachableFrom.end())
+        Cached = ReachableFrom.insert({From, reachableBlocks(From)}).first;
+    auto &reachable = Cached->second;
+    return reachable.count() >= ReachabilitySearchLimit ||
+           containsNumber(reachable, getNumber(To));
+}
+
+/// Get the number of an instruction. Instructions are numbered in the order
+/// in which they are first used.
+unsigned VarDependencySlicer::getNumber(const Instruction *Instr) {
+    auto Number = InstrNumbers.insert({Instr, Instrs.size()});
+    if (Number.second)
+        Instrs.push_back(Instr);
+    return Number.first->second;
 }
 
-/// Set union. Result is stored in the first set.
-void VarDependencySlicer::uniteWith(
-        std::set<const BasicBlock *> &set,
-        const std::set<const BasicBlock *> &other) {
-    std::set<const BasicBlock *> tmpSet;
-    std::set_union(set.begin(), set.end(), other.begin(), other.end(),
-                   std::inserter(tmpSet, tmpSet.begin()));
-    set = std::move(tmpSet);
+/// Get the number of a basic block. Blocks are numbered in the order in which
+/// they are first used.
+unsigned VarDependencySlicer::getNumber(const BasicBlock *BB) {
+    auto Number = BlockNumbers.insert({BB, Blocks.size()});
+    if (Number.second)
+        Blocks.push_back(BB);
+    return Number.first->second;
 }
 
 /// Check if an instruction is dependent on the value of the global variable.
 bool VarDependencySlicer::isDependent(const Instruction *Instr) {
-    return DependentInstrs.find(Instr) != DependentInstrs.end();
+    return containsNumber(DependentInstrs, getNumber(Instr));
 }
 
 /// Check if an instruction must be included.
 bool VarDependencySlicer::isIncluded(const Instruction *Instr) {
-    return IncludedInstrs.find(Instr) != IncludedInstrs.end();
+    return containsNumber(IncludedInstrs, getNumber(Instr));
 }
 
 // Check if a basic block is affected by the value of the global variable.
 bool VarDependencySlicer::isAffected(const BasicBlock *BB) {
-    return AffectedBasicBlocks.find(BB) != AffectedBasicBlocks.end();
+    return containsNumber(AffectedBasicBlocks, getNumber(BB));
 }
 
 // Check if a basic block must be included.
 bool VarDependencySlicer::isIncluded(const BasicBlock *BB) {
-    return IncludedBasicBlocks.find(BB) != IncludedBasicBlocks.end();
+    return containsNumber(IncludedBasicBlocks, getNumber(BB));
 }
 
 // Check if a function parameter must be included.
 bool VarDependencySlicer::isIncluded(const Argument *Param) {
-    return IncludedParams.find(Param) != IncludedParams.end();
+    return containsNumber(IncludedParams, Param->getArgNo());
 }
 
 // Check if the instruction is a debug info that must be included.
@@ -564,7 +632,9 @@ bool VarDependencySlicer::checkPhiDependency(const PHINode &Phi) {
         if (!isIncluded(incomingBB)) {
             auto *BBVal = Phi.getIncomingValueForBlock(incomingBB);
             if (BBVal != Val) {
-                for (auto included : IncludedBasicBlocks) {
+                for (int i = IncludedBasicBlocks.find_first(); i != -1;
+                     i = IncludedBasicBlocks.find_next(i)) {
+                    auto included = Blocks[i];
                     // Do not consider those blocks whose terminator is not
                     // included (since we search for included blocks where both
                     // branches can be included and one of them leads through
@@ -573,10 +643,10 @@ bool VarDependencySlicer::checkPhiDependency(const PHINode &Phi) {
                         continue;
 
                     if (included->getTerminator()->getNumSuccessors() == 2) {
-                        if (isPotentiallyReachable(
+                        if (potentiallyReachable(
                                 included->getTerminator()->getSuccessor(0),
                                 incomingBB) !=
-                                isPotentiallyReachable(
+                                potentiallyReachable(
                                         included->getTerminator()->getSuccessor(
                                                 1),
                                         incomingBB))
@@ -590,90 +660,85 @@ bool VarDependencySlicer::checkPhiDependency(const PHINode &Phi) {
 }
 
 /// Add all stores to an allocated memory between the allocation and a read
-/// access into included.
-bool VarDependencySlicer::addStoresToIncluded(const Instruction *Alloca,
-                                              const Instruction *Use) {
+/// access into included. The memory accessed via bitcasts and GEPs of the
+/// allocation is searched, too.
+/// The instructions are searched along the CFG from the allocation (or from
+/// the bitcast or GEP) until the read access is reached. Only successors of
+/// branch instructions are followed and each block is entered at most once.
+/// \param Worklist Newly included instructions are added to the worklist so
+///                 that their operands can be included, too.
+bool VarDependencySlicer::addStoresToIncluded(
+        const Instruction *Alloca,
+        const Instruction *Use,
+        std::vector<const Instruction *> &Worklist) {
     bool added = false;
-    std::list<const Instruction *> worklist;
-    worklist.push_back(Alloca->getNextNode());
-    std::set<const Instruction *> visited;
-    visited.insert(Alloca);
-    visited.insert(Use);
-    while (!worklist.empty()) {
-        const Instruction *Current = worklist.front();
-        worklist.pop_front();
-        // Add store instruction with alloca as operand
-        if (auto Store = dyn_cast<StoreInst>(Current)) {
-            if (Store->getPointerOperand() == Alloca) {
-                if (addToIncluded(Store)) {
-                    added = true;
-                    addAllOpsToIncluded(Store);
+    std::vector<const Instruction *> pointers = {Alloca};
+    while (!pointers.empty()) {
+        const Instruction *Ptr = pointers.back();
+        pointers.pop_back();
+
+        BitVector visited;
+        std::vector<BasicBlock::const_iterator> starts = {
+                std::next(Ptr->getIterator())};
+        while (!starts.empty()) {
+            auto Start = starts.back();
+            starts.pop_back();
+            for (auto Inst = Start; Inst != Start->getParent()->end();
+                 ++Inst) {
+                const Instruction *Current = &*Inst;
+                if (Current == Ptr || Current == Use)
+                    break;
+
+                // Add store instruction with pointer as operand
+                if (auto Store = dyn_cast<StoreInst>(Current)) {
+                    if (Store->getPointerOperand() == Ptr) {
+                        if (addToIncluded(Store)) {
+                            added = true;
+                            Worklist.push_back(Store);
+                        }
+                    }
                 }
-            }
-        }
-        // Add call instruction with alloca as operand
-        if (auto Call = dyn_cast<CallInst>(Current)) {
-            for (auto &Op : Call->operands()) {
-                if (Op == Alloca) {
-                    if (addToIncluded(Call)) {
-                        added = true;
-                        addAllOpsToIncluded(Call);
+                // Add call instruction with pointer as operand
+                if (auto Call = dyn_cast<CallInst>(Current)) {
+                    for (auto &Op : Call->operands()) {
+                        if (Op == Ptr) {
+                            if (addToIncluded(Call)) {
+                                added = true;
+                                Worklist.push_back(Call);
+                            }
+                        }
                     }
                 }
-            }
-        }
-        // If alloca is bitcasted or GEP-ed, run search for current
-        if (auto BitCast = dyn_cast<BitCastInst>(Current)) {
-            if (BitCast->getOperand(0) == Alloca)
-                if (addStoresToIncluded(Current, Use))
-                    added = true;
-        }
-        if (auto GEP = dyn_cast<GetElementPtrInst>(Current)) {
-            if (GEP->getPointerOperand() == Alloca)
-                if (addStoresToIncluded(Current, Use))
-                    added = true;
-        }
+                // If pointer is bitcasted or GEP-ed, run search for current
+                if (auto BitCast = dyn_cast<BitCastInst>(Current)) {
+                    if (BitCast->getOperand(0) == Ptr)
+                        pointers.push_back(Current);
+                }
+                if (auto GEP = dyn_cast<GetElementPtrInst>(Current)) {
+                    if (GEP->getPointerOperand() == Ptr)
+                        pointers.push_back(Current);
+                }
 
-        std::vector<const Instruction *> next;
-        if (auto Branch = dyn_cast<BranchInst>(Current)) {
-            for (auto succ : Branch->successors())
-                next.push_back(&*succ->begin());
-        } else {
-            if (Current->getNextNode())
-                next.push_back(Current->getNextNode());
-        }
-        for (auto &n : next) {
-            if (visited.find(n) == visited.end())
-                worklist.push_back(n);
+                if (auto Branch = dyn_cast<BranchInst>(Current)) {
+                    for (auto succ : Branch->successors()) {
+                        unsigned SuccNumber = getNumber(succ);
+                        if (!containsNumber(visited, SuccNumber)) {
+                            insertNumber(visited, SuccNumber);
+                            starts.push_back(succ->begin());
+                        }
+                    }
+                }
+            }
         }
-
-        visited.insert(Current);
     }
     return added;
 }
 
-/// Recursively calculate the set of all blocks reachable from BB.
-/// \param BB Block to search from
-/// \param Reachable Set of reachale blocks (new found blocks will be added).
-/// \param Visited Set of visited blocks.
-void calculateReachableBlocksRecursive(BasicBlock *BB,
-                                       std::set<BasicBlock *> &Reachable,
-                                       std::set<BasicBlock *> &Visited) {
-    if (Visited.find(BB) != Visited.end())
-        return;
-    Visited.insert(BB);
-
-    for (auto Succ : successors(BB)) {
-        Reachable.insert(Succ);
-        calculateReachableBlocksRecursive(Succ, Reachable, Visited);
-    }
-}
-
 /// Deleting unreachable blocks.
 void VarDependencySlicer::deleteUnreachableBlocks(Function &Fun) {
-    std::set<BasicBlock *> Reachable = {&Fun.getEntryBlock()};
-    std::set<BasicBlock *> Visited;
-    calculateReachableBlocksRecursive(&Fun.getEntryBlock(), Reachable, Visited);
+    std::set<BasicBlock *> Reachable;
+    for (auto BB : depth_first(&Fun.getEntryBlock()))
+        Reachable.insert(BB);
 
     std::vector<BasicBlock *> toRemove;
     for (auto &BB : Fun) {
@@ -15,6 +15,8 @@
 #ifndef PROJECT_VARDEPENDENCYSLICER_H
 #define PROJECT_VARDEPENDENCYSLICER_H
 
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/PassManager.h>
 #include <set>
@@ -26,6 +28,8 @@ using namespace llvm;
 /// the variable are kept, the rest is removed.
 /// Also, additional instructions that are needed to produce a valid LLVM module
 /// are kept.
+/// Instructions and basic blocks of the sliced function are densely numbered
+/// and all sets of them are represented by bit vectors indexed by the numbers.
 class VarDependencySlicer : public PassInfoMixin<VarDependencySlicer> {
   public:
     PreservedAnalyses run(Function &Fun, FunctionAnalysisManager &fam,
@@ -33,28 +37,45 @@ class VarDependencySlicer : public PassInfoMixin<VarDependencySlicer> {
 
   private:
     GlobalVariable *Variable = nullptr;
+
+    // Numbering of instructions and basic blocks (new values are numbered
+    // when they are first used)
+    DenseMap<const Instruction *, unsigned> InstrNumbers;
+    std::vector<const Instruction *> Instrs;
+    DenseMap<const BasicBlock *, unsigned> BlockNumbers;
+    std::vector<const BasicBlock *> Blocks;
+
     // Instructions directly dependent on the parameter
-    std::set<const Instruction *> DependentInstrs = {};
+    BitVector DependentInstrs;
     // Instructions that must be included
-    std::set<const Instruction *> IncludedInstrs = {};
+    BitVector IncludedInstrs;
     // Basics blocks whose execution is dependent on the parameter
-    std::set<const BasicBlock *> AffectedBasicBlocks = {};
+    BitVector AffectedBasicBlocks;
     // Basic blocks that must be included
-    std::set<const BasicBlock *> IncludedBasicBlocks = {};
-    // Function parameters to be included
-    std::set<const Argument *> IncludedParams = {};
+    BitVector IncludedBasicBlocks;
+    // Function parameters to be included (indexed by the argument number)
+    BitVector IncludedParams;
+
+    // Blocks reachable from each block in the current CFG (must be cleared
+    // whenever the CFG changes)
+    DenseMap<const BasicBlock *, BitVector> ReachableFrom;
 
     // Return block
     BasicBlock *RetBB = nullptr;
 
+    // Numbering
+    unsigned getNumber(const Instruction *Instr);
+    unsigned getNumber(const BasicBlock *BB);
+
     // Functions for adding to sets
     void addAllInstrs(const std::vector<const BasicBlock *> BBs);
-    bool addToSet(const Instruction *Inst,
-                  std::set<const Instruction *> &set);
+    bool addToSet(const Instruction *Inst, BitVector &set);
     bool addToDependent(const Instruction *Instr);
     bool addToIncluded(const Instruction *Inst);
     bool addAllOpsToIncluded(const Instruction *Inst);
-    bool addStoresToIncluded(const Instruction *Alloca, const Instruction *Use);
+    bool addStoresToIncluded(const Instruction *Alloca,
+                             const Instruction *Use,
+                             std::vector<const Instruction *> &Worklist);
 
     // Functions for searching sets
     inline bool isDependent(const Instruction *Instr);
@@ -71,17 +92,11 @@ class VarDependencySlicer : public PassInfoMixin<VarDependencySlicer> {
     bool checkPhiDependency(const PHINode &Phi);
 
     // Computing reachable blocks
-    std::set<const BasicBlock *> reachableBlocks(const BasicBlock *Src,
-                                                 Function &Fun);
-    std::set<const BasicBlock *> reachableBlocksThroughSucc(
-            TerminatorInst *Terminator,
-            BasicBlock *Succ);
-
-    // Set operations
-    void intersectWith(std::set<const BasicBlock *> &set,
-                       const std::set<const BasicBlock *> &other);
-    void uniteWith(std::set<const BasicBlock *> &set,
-                   const std::set<const BasicBlock *> &other);
+    BitVector reachableBlocks(const BasicBlock *Src,
+                              const BasicBlock *Sink = nullptr);
+    BitVector reachableBlocksThroughSucc(TerminatorInst *Terminator,
+                                         BasicBlock *Succ);
+    bool potentiallyReachable(const BasicBlock *From, const BasicBlock *To);
 
     bool checkDependency(const Use *Op);
 
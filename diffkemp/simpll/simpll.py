@@ -2,16 +2,228 @@
 Simplifying LLVM modules with the SimpLL tool.
 """
 from diffkemp.semdiff.result import Result
-from diffkemp.llvm_ir.kernel_module import LlvmKernelModule
+from diffkemp.llvm_ir.kernel_module import LlvmKernelModule, \
+    get_ir_input_file
+from collections import OrderedDict
+import atexit
+import json
 import os
-from subprocess import check_call, check_output, CalledProcessError
+import tempfile
+from subprocess import check_call, check_output, CalledProcessError, Popen, \
+    PIPE, DEVNULL
 import yaml
 
+SIMPLL = "build/diffkemp/simpll/simpll"
+
 
 class SimpLLException(Exception):
     pass
 
 
+class SimpLLStats:
+    """
+    Statistics of SimpLL runs (reported by SimpLL with the --stats option)
+    accumulated over multiple runs. Times of the phases and the counters are
+    summed, the peak RSS is the maximum over all runs.
+    """
+    def __init__(self):
+        self.runs = 0
+        # Phase name -> [wall time, CPU time] (in seconds)
+        self.phases = OrderedDict()
+        self.counters = OrderedDict()
+        self.peak_rss = 0
+
+    def add(self, stats):
+        """
+        Add statistics of a single SimpLL run.
+        :param stats: Contents of the "stats" section of the SimpLL output.
+        """
+        self.runs += 1
+        for phase in stats.get("phases", []):
+            times = self.phases.setdefault(phase["phase"], [0.0, 0.0])
+            times[0] += float(phase["wall-time"])
+            times[1] += float(phase["cpu-time"])
+        for name, value in stats.items():
+            if name == "phases":
+                continue
+            if name == "peak-rss-kb":
+                self.peak_rss = max(self.peak_rss, int(value))
+            else:
+                self.counters[name] = self.counters.get(name, 0) + int(value)
+
+    def merge(self, other):
+        """Add statistics accumulated by another instance."""
+        self.runs += other.runs
+        for name, (wall, cpu) in other.phases.items():
+            times = self.phases.setdefault(name, [0.0, 0.0])
+            times[0] += wall
+            times[1] += cpu
+        for name, value in other.counters.items():
+            self.counters[name] = self.counters.get(name, 0) + value
+        self.peak_rss = max(self.peak_rss, other.peak_rss)
+
+    def report(self):
+        """Print the statistics to stdout."""
+        print("SimpLL runs: {}".format(self.runs))
+        print("{:<20}{:>12}{:>12}".format("Phase", "Wall [s]", "CPU [s]"))
+        for name, (wall, cpu) in self.phases.items():
+            print("{:<20}{:>12.3f}{:>12.3f}".format(name, wall, cpu))
+        for name, value in self.counters.items():
+            print("{}: {}".format(name, value))
+        print("peak-rss: {} kB".format(self.peak_rss))
+
+
+# Statistics of SimpLL runs done by the current process (None if they are not
+# collected)
+_stats = None
+
+
+def enable_stats():
+    """
+    Start collecting statistics of SimpLL runs. Statistics collected so far
+    are discarded.
+    """
+    global _stats
+    _stats = SimpLLStats()
+
+
+def get_stats():
+    """Get statistics of SimpLL runs (None if they are not collected)."""
+    return _stats
+
+
+def _add_stats(simpll_result):
+    """
+    Add statistics from a YAML document of the SimpLL output. In the batch
+    mode (--fun-list) and in the multi-variable mode (--var-list), SimpLL
+    prints the statistics of the whole run in the first document only, hence
+    this must be called for each document of the output.
+    """
+    if (_stats is not None and simpll_result is not None and
+            "stats" in simpll_result):
+        _stats.add(simpll_result["stats"])
+
+
+class SimpLLServer:
+    """
+    SimpLL running in the server mode. The server keeps parsed modules in
+    memory, hence modules shared by multiple compared functions are parsed
+    only once.
+    """
+    def __init__(self, verbose=False, cache_dir=None, stats=False):
+        command = [SIMPLL, "--server"]
+        if cache_dir:
+            command.extend(["--cache-dir", cache_dir])
+        if stats:
+            command.append("--stats")
+        if verbose:
+            command.append("--verbose")
+        self.stderr = None if verbose else open(os.devnull, "w")
+        self.process = Popen(command, stdin=PIPE, stdout=PIPE,
+                             stderr=self.stderr)
+        # Options of the server (a server with different options cannot be
+        # reused)
+        self.verbose = verbose
+        self.cache_dir = cache_dir
+        self.stats = stats
+        # Process that started the server (only that one may use it)
+        self.owner = os.getpid()
+
+    def running(self):
+        """Check if the server process is still running."""
+        return self.process.poll() is None
+
+    def request(self, options):
+        """
+        Send a comparison request to the server and wait for the result.
+        :param options: Dictionary with the request options. Their names are
+                        the same as names of the SimpLL CLI options, input
+                        files are given by "first" and "second".
+        :return: Output of SimpLL (YAML report).
+        """
+        try:
+            self.process.stdin.write(
+                json.dumps(options).encode("utf-8") + b"\n")
+            self.process.stdin.flush()
+            response = []
+            while True:
+                line = self.process.stdout.readline()
+                if not line:
+                    raise SimpLLException("SimpLL server terminated")
+                response.append(line)
+                # Each response is terminated by the YAML document end marker
+                if line.rstrip() == b"...":
+                    break
+        except (IOError, ValueError):
+            raise SimpLLException("SimpLL server terminated")
+        return b"".join(response)
+
+    def stop(self):
+        """Stop the server by closing its input."""
+        if self.running():
+            self.process.stdin.close()
+            self.process.wait()
+        if self.stderr is not None:
+            self.stderr.close()
+
+
+# SimpLL server used by the current process
+_server = None
+
+
+def get_server(verbose=False, cache_dir=None):
+    """
+    Get the SimpLL server for the current process. The server is started on
+    the first use and it is restarted if it terminated or if it was started
+    with different options (including collecting of statistics).
+    """
+    global _server
+    stats = _stats is not None
+    if (_server is None or _server.owner != os.getpid() or
+            not _server.running() or
+            (_server.verbose, _server.cache_dir, _server.stats) !=
+            (verbose, cache_dir, stats)):
+        if _server is not None and _server.owner == os.getpid():
+            _server.stop()
+        _server = SimpLLServer(verbose, cache_dir, stats)
+    return _server
+
+
+@atexit.register
+def stop_server():
+    """Stop the SimpLL server of the current process (if running)."""
+    global _server
+    if _server is not None and _server.owner == os.getpid():
+        _server.stop()
+    _server = None
+
+
+def _inlining_budget_options(inlining_budget):
+    """
+    Get SimpLL options setting the inlining budget.
+    :param inlining_budget: Triple (maximal number of inlining rounds, maximal
+                            number of instructions added by inlining, maximal
+                            size of an inlined function), 0 means no limit.
+                            None if inlining is not limited.
+    :return: Dictionary mapping names of the options to their values.
+    """
+    if not inlining_budget:
+        return OrderedDict()
+    return OrderedDict(
+        (name, value)
+        for name, value in zip(["max-inlining-rounds", "max-inlining-growth",
+                                "max-inlined-size"], inlining_budget)
+        if value)
+
+
+def _budget_args(inlining_budget):
+    """Get SimpLL CLI arguments setting the inlining budget."""
+    args = []
+    for name, value in _inlining_budget_options(inlining_budget).items():
+        args.extend(["--" + name, str(value)])
+    return args
+
+
 def add_suffix(file, suffix):
     """Add suffix to the file name."""
     name, ext = os.path.splitext(file)
@@ -19,57 +231,116 @@ def add_suffix(file, suffix):
 
 
 def simplify_modules_diff(first, second, fun_first, fun_second, var,
-                          suffix=None, control_flow_only=False, verbose=False):
+                          suffix=None, control_flow_only=False, verbose=False,
+                          use_server=False, cache_dir=None,
+                          link_indices=(None, None), parallel=False,
+                          drop_unreachable=False, inlining_budget=None,
+                          drop_debug_info=False):
     """
     Simplify modules to ease their semantic difference. Uses the SimpLL tool.
+    If use_server is set, the comparison is done by a persistent SimpLL server
+    instead of running a new SimpLL process.
+    If cache_dir is set, results of function comparisons are stored into it
+    and reused by subsequent comparisons.
+    If link_indices contain indices of modules defining symbols (for the first
+    and the second program), SimpLL links definitions of missing functions
+    into the compared modules itself. Definitions that are not found in
+    the indices are reported as missing.
+    If parallel is set, SimpLL preprocesses the compared modules in parallel.
+    If drop_unreachable is set, SimpLL deletes bodies of functions that are
+    not reachable from the compared functions before the comparison.
+    If inlining_budget is set, it limits inlining when comparing a pair of
+    functions. It is a triple (maximal number of inlining rounds, maximal
+    number of instructions added by inlining, maximal size of an inlined
+    function), 0 means no limit.
+    If drop_debug_info is set, SimpLL drops debug metadata of functions that
+    are not reachable from the compared functions once the debug info is
+    processed.
+    If all functions are syntactically equal, SimpLL does not write the
+    simplified modules and None is returned instead of them.
+    Functions whose comparison did not finish (e.g. because the inlining
+    budget was exhausted) are returned in a list of dictionaries with the
+    "first", "second", and "reason" keys.
     """
-    stderr = None
-    if not verbose:
-        stderr = open(os.devnull, "w")
-
     first_out_name = add_suffix(first, suffix) if suffix else first
     second_out_name = add_suffix(second, suffix) if suffix else second
 
     try:
-        simpll_command = ["build/diffkemp/simpll/simpll", first, second,
-                          "--print-callstacks"]
         # Main (analysed) functions
-        simpll_command.append("--fun")
         if fun_first != fun_second:
-            simpll_command.append("{},{}".format(fun_first, fun_second))
+            fun = "{},{}".format(fun_first, fun_second)
         else:
-            simpll_command.append(fun_first)
-        # Analysed variable
-        if var:
-            simpll_command.extend(["--var", var])
-        # Suffix for output files
-        if suffix:
-            simpll_command.extend(["--suffix", suffix])
+            fun = fun_first
 
-        if control_flow_only:
-            simpll_command.append("--control-flow")
+        if use_server:
+            request = {"first": get_ir_input_file(first),
+                       "second": get_ir_input_file(second), "fun": fun,
+                       "print-callstacks": True,
+                       "control-flow": control_flow_only,
+                       "verdict-only": True, "parallel": parallel,
+                       "drop-unreachable": drop_unreachable,
+                       "drop-unreachable-debug-info": drop_debug_info}
+            request.update(_inlining_budget_options(inlining_budget))
+            if var:
+                request["var"] = var
+            if suffix:
+                request["suffix"] = suffix
+            if link_indices[0]:
+                request["first-link-index"] = link_indices[0]
+            if link_indices[1]:
+                request["second-link-index"] = link_indices[1]
+            if verbose:
+                print(json.dumps(request))
+            simpll_out = get_server(verbose, cache_dir).request(request)
+        else:
+            simpll_command = [SIMPLL, get_ir_input_file(first),
+                              get_ir_input_file(second), "--print-callstacks",
+                              "--verdict-only", "--fun", fun]
+            # Analysed variable
+            if var:
+                simpll_command.extend(["--var", var])
+            # Suffix for output files
+            if suffix:
+                simpll_command.extend(["--suffix", suffix])
 
-        if verbose:
-            simpll_command.append("--verbose")
-            print(" ".join(simpll_command))
+            if control_flow_only:
+                simpll_command.append("--control-flow")
+
+            if cache_dir:
+                simpll_command.extend(["--cache-dir", cache_dir])
+
+            if link_indices[0]:
+                simpll_command.extend(["--first-link-index", link_indices[0]])
+            if link_indices[1]:
+                simpll_command.extend(["--second-link-index",
+                                       link_indices[1]])
+            if parallel:
+                simpll_command.append("--parallel")
+            if drop_unreachable:
+                simpll_command.append("--drop-unreachable")
+            if drop_debug_info:
+                simpll_command.append("--drop-unreachable-debug-info")
+            simpll_command.extend(_budget_args(inlining_budget))
 
-        simpll_out = check_output(simpll_command)
-        check_call(["opt", "-S", "-deadargelim", "-o", first_out_name,
-                    first_out_name],
-                   stderr=stderr)
-        check_call(["opt", "-S", "-deadargelim", "-o", second_out_name,
-                    second_out_name],
-                   stderr=stderr)
+            if _stats is not None:
+                simpll_command.append("--stats")
 
-        first_out = LlvmKernelModule(first_out_name)
-        second_out = LlvmKernelModule(second_out_name)
+            if verbose:
+                simpll_command.append("--verbose")
+                print(" ".join(simpll_command))
+
+            simpll_out = check_output(simpll_command)
 
         objects_to_compare = []
         missing_defs = None
         syndiff_defs = None
+        unknown_funs = []
         try:
             simpll_result = yaml.safe_load(simpll_out)
+            _add_stats(simpll_result)
             if simpll_result is not None:
+                if "error" in simpll_result:
+                    raise SimpLLException(simpll_result["error"])
                 if "diff-functions" in simpll_result:
                     for fun_pair_yaml in simpll_result["diff-functions"]:
                         fun_pair = [
@@ -95,10 +366,176 @@ def simplify_modules_diff(first, second, fun_first, fun_second, var,
                     if "missing-defs" in simpll_result else None
                 syndiff_defs = simpll_result["syndiff-defs"] \
                     if "syndiff-defs" in simpll_result else None
+                if "unknown-functions" in simpll_result:
+                    unknown_funs = simpll_result["unknown-functions"]
         except yaml.YAMLError:
             pass
 
+        # Simplified modules are written only if some functions differ
+        first_out = None
+        second_out = None
+        if objects_to_compare:
+            first_out = LlvmKernelModule(first_out_name)
+            second_out = LlvmKernelModule(second_out_name)
+
         return first_out, second_out, objects_to_compare, missing_defs, \
-            syndiff_defs
+            syndiff_defs, unknown_funs
+    except CalledProcessError:
+        raise SimpLLException("Simplifying files failed")
+
+
+def compare_function_list(first, second, funs, control_flow_only=False,
+                          verbose=False, cache_dir=None, parallel=False,
+                          drop_unreachable=False, inlining_budget=None,
+                          drop_debug_info=False):
+    """
+    Compare multiple functions from the same modules in a single SimpLL run.
+    The modules are simplified only once and functions called by multiple
+    compared functions are compared only once.
+    :param first: File with the first LLVM module.
+    :param second: File with the second LLVM module.
+    :param funs: List of names of the compared functions.
+    :return: Set of functions that are syntactically equal. Other functions
+             must be compared separately using simplify_modules_diff.
+    If statistics are collected, they are added once for the whole run.
+    """
+    fun_list = tempfile.NamedTemporaryFile(mode="w", suffix=".txt",
+                                           delete=False)
+    try:
+        with fun_list:
+            fun_list.write("\n".join(funs) + "\n")
+
+        simpll_command = [SIMPLL, get_ir_input_file(first),
+                          get_ir_input_file(second), "--report-only",
+                          "--fun-list", fun_list.name]
+        if control_flow_only:
+            simpll_command.append("--control-flow")
+        if cache_dir:
+            simpll_command.extend(["--cache-dir", cache_dir])
+        if parallel:
+            simpll_command.append("--parallel")
+        if drop_unreachable:
+            simpll_command.append("--drop-unreachable")
+        if drop_debug_info:
+            simpll_command.append("--drop-unreachable-debug-info")
+        simpll_command.extend(_budget_args(inlining_budget))
+        if _stats is not None:
+            simpll_command.append("--stats")
+        if verbose:
+            simpll_command.append("--verbose")
+            print(" ".join(simpll_command))
+
+        # Simplified modules are not needed, only the results are reported
+        simpll_out = check_output(simpll_command,
+                                  stderr=None if verbose else DEVNULL)
+    except CalledProcessError:
+        raise SimpLLException("Simplifying files failed")
+    finally:
+        os.remove(fun_list.name)
+
+    equal = set()
+    try:
+        for simpll_result in yaml.safe_load_all(simpll_out):
+            _add_stats(simpll_result)
+            if (simpll_result is None or "function" not in simpll_result or
+                    "diff-functions" in simpll_result or
+                    "missing-defs" in simpll_result or
+                    "unknown-functions" in simpll_result):
+                continue
+            equal.add(simpll_result["function"])
+    except yaml.YAMLError:
+        pass
+    return equal
+
+
+def compare_variable_list(first, second, fun, variables,
+                          control_flow_only=False, verbose=False,
+                          cache_dir=None, parallel=False,
+                          drop_unreachable=False, inlining_budget=None,
+                          drop_debug_info=False):
+    """
+    Compare a function w.r.t. the values of multiple global variables in
+    a single SimpLL run. The modules are preprocessed only once, then the
+    function is sliced w.r.t. each variable separately.
+    :param first: File with the first LLVM module.
+    :param second: File with the second LLVM module.
+    :param fun: Name of the compared function.
+    :param variables: List of names of the global variables.
+    :return: Set of variables w.r.t. which the function is syntactically
+             equal. The function must be compared w.r.t. the other variables
+             separately using simplify_modules_diff.
+    If statistics are collected, they are added once for the whole run.
+    """
+    var_list = tempfile.NamedTemporaryFile(mode="w", suffix=".txt",
+                                           delete=False)
+    try:
+        with var_list:
+            var_list.write("\n".join(variables) + "\n")
+
+        simpll_command = [SIMPLL, get_ir_input_file(first),
+                          get_ir_input_file(second), "--report-only",
+                          "--fun", fun, "--var-list", var_list.name]
+        if control_flow_only:
+            simpll_command.append("--control-flow")
+        if cache_dir:
+            simpll_command.extend(["--cache-dir", cache_dir])
+        if parallel:
+            simpll_command.append("--parallel")
+        if drop_unreachable:
+            simpll_command.append("--drop-unreachable")
+        if drop_debug_info:
+            simpll_command.append("--drop-unreachable-debug-info")
+        simpll_command.extend(_budget_args(inlining_budget))
+        if _stats is not None:
+            simpll_command.append("--stats")
+        if verbose:
+            simpll_command.append("--verbose")
+            print(" ".join(simpll_command))
+
+        # Simplified modules are not needed, only the results are reported
+        simpll_out = check_output(simpll_command,
+                                  stderr=None if verbose else DEVNULL)
     except CalledProcessError:
         raise SimpLLException("Simplifying files failed")
+    finally:
+        os.remove(var_list.name)
+
+    equal = set()
+    try:
+        for simpll_result in yaml.safe_load_all(simpll_out):
+            _add_stats(simpll_result)
+            if (simpll_result is None or "variable" not in simpll_result or
+                    "diff-functions" in simpll_result or
+                    "missing-defs" in simpll_result or
+                    "unknown-functions" in simpll_result):
+                continue
+            equal.add(simpll_result["variable"])
+    except yaml.YAMLError:
+        pass
+    return equal
+
+
+def generate_symbol_index(llvm_files, index_file):
+    """
+    Create an index of LLVM modules defining symbols (functions and global
+    variables) using SimpLL. Paths of the modules in the index are relative to
+    the directory containing the index.
+    :param llvm_files: List of files with the indexed modules.
+    :param index_file: File to write the index to.
+    """
+    index_dir = os.path.dirname(os.path.abspath(index_file))
+    mod_list = tempfile.NamedTemporaryFile(mode="w", suffix=".txt",
+                                           delete=False)
+    try:
+        with mod_list:
+            mod_list.write("\n".join([os.path.relpath(f, index_dir)
+                                      for f in llvm_files]) + "\n")
+        with open(index_file, "w") as index:
+            check_call([os.path.abspath(SIMPLL), "--symbol-index",
+                        mod_list.name],
+                       stdout=index, cwd=index_dir)
+    except CalledProcessError:
+        os.remove(index_file)
+        raise SimpLLException("Generating symbol index failed")
+    finally:
+        os.remove(mod_list.name)
@@ -4,12 +4,20 @@ Tests are specified using YAML files in the tests/test_specs directory.
 This module runs tests for single functions specified using the "functions"
 key in the YAML spec file.
 """
+from diffkemp.diffkemp import _compare_group, _group_by_modules, \
+    _init_worker
 from diffkemp.semdiff.function_diff import functions_diff
 from diffkemp.semdiff.result import Result
+from diffkemp.simpll.simpll import compare_function_list, \
+    simplify_modules_diff, stop_server, SIMPLL
+from multiprocessing import Pool
+from subprocess import check_output
 from tests.regression.task_spec import TaskSpec, specs_path, tasks_path
+import copy
 import glob
 import os
 import pytest
+import time
 import yaml
 
 
@@ -77,3 +85,378 @@ def test_function_diff(task_spec):
                 fun_first=fun_spec.name, fun_second=fun_spec.name,
                 glob_var=None, config=task_spec.config)
             assert result.kind == fun_spec.result
+
+
+def test_function_diff_deterministic(task_spec):
+    """
+    Test that repeated comparisons of functions give the same results,
+    including the same differing called functions (the order in which SimpLL
+    compares the called functions must not depend on the memory layout).
+    """
+    results = []
+    for _ in range(2):
+        for fun_spec in task_spec.functions.values():
+            if fun_spec.result != Result.Kind.TIMEOUT:
+                result = functions_diff(
+                    mod_first=fun_spec.old_module,
+                    mod_second=fun_spec.new_module,
+                    fun_first=fun_spec.name, fun_second=fun_spec.name,
+                    glob_var=None, config=task_spec.config)
+                assert result.kind == fun_spec.result
+                results.append((result.kind,
+                                sorted((name, res.kind)
+                                       for name, res in result.inner.items())))
+    assert results[:len(results) // 2] == results[len(results) // 2:]
+
+
+def _write_module(directory, name, lines):
+    """Write an LLVM module consisting of the given lines into a file."""
+    path = os.path.join(str(directory), "{}.ll".format(name))
+    with open(path, "w") as mod:
+        mod.write("\n".join(lines) + "\n")
+    return path
+
+
+def _write_call_chain(directory, name, length, leaf_inc):
+    """
+    Write an LLVM module containing a chain of functions f0 -> ... -> f<length>
+    and a pair of mutually recursive functions even and odd called from f0.
+    The last function of the chain adds leaf_inc to its argument.
+    """
+    lines = []
+    for i in range(length):
+        lines.append("define i32 @f{}(i32 %x) {{".format(i))
+        if i == 0:
+            lines.append("  %e = call i32 @even(i32 %x)")
+            lines.append("  %r = call i32 @f1(i32 %e)")
+        else:
+            lines.append("  %r = call i32 @f{}(i32 %x)".format(i + 1))
+        lines.append("  ret i32 %r")
+        lines.append("}")
+    lines.append("define i32 @f{}(i32 %x) {{".format(length))
+    lines.append("  %r = add i32 %x, {}".format(leaf_inc))
+    lines.append("  ret i32 %r")
+    lines.append("}")
+    for fun, other, base in [("even", "odd", 1), ("odd", "even", 0)]:
+        lines.extend([
+            "define i32 @{}(i32 %n) {{".format(fun),
+            "  %z = icmp eq i32 %n, 0",
+            "  br i1 %z, label %base, label %rec",
+            "base:",
+            "  ret i32 {}".format(base),
+            "rec:",
+            "  %m = sub i32 %n, 1",
+            "  %r = call i32 @{}(i32 %m)".format(other),
+            "  ret i32 %r",
+            "}"])
+    return _write_module(directory, name, lines)
+
+
+def test_deep_call_chain(tmpdir):
+    """
+    Test comparing functions with a long chain of callees and with recursive
+    callees. The comparison must not overflow the stack and its results must
+    be the same in repeated runs.
+    """
+    length = 5000
+    first = _write_call_chain(tmpdir, "first", length, 1)
+    second_equal = _write_call_chain(tmpdir, "equal", length, 1)
+    second_diff = _write_call_chain(tmpdir, "diff", length, 2)
+    for _ in range(2):
+        _, _, objects_to_compare, _, _, unknown_funs = \
+            simplify_modules_diff(first, second_equal, "f0", "f0", None,
+                                  "simpl")
+        assert not objects_to_compare
+        assert not unknown_funs
+
+        _, _, objects_to_compare, _, _, unknown_funs = \
+            simplify_modules_diff(first, second_diff, "f0", "f0", None,
+                                  "simpl")
+        assert [o[0].name for o in objects_to_compare] == \
+            ["f{}".format(length)]
+        assert not unknown_funs
+
+
+def _write_inlining_chain(directory, name, length, inlined, last_factor):
+    """
+    Write an LLVM module containing a function f that applies functions g1,
+    ..., g<length> to its argument in a sequence. Each gi multiplies its
+    argument by a factor and passes the result to an external function.
+    If inlined is set, bodies of gi are written directly in f, otherwise f
+    calls them. The factor of the last function is last_factor.
+    """
+    lines = ["declare i32 @ext(i32)"]
+    body = []
+    for i in range(1, length + 1):
+        factor = last_factor if i == length else i + 1
+        lines.extend([
+            "define i32 @g{}(i32 %x) {{".format(i),
+            "  %y = mul i32 %x, {}".format(factor),
+            "  %r = call i32 @ext(i32 %y)",
+            "  ret i32 %r",
+            "}"])
+        if inlined:
+            body.extend([
+                "  %y{} = mul i32 %a{}, {}".format(i, i - 1, factor),
+                "  %a{} = call i32 @ext(i32 %y{})".format(i, i)])
+        else:
+            body.append("  %a{} = call i32 @g{}(i32 %a{})".format(i, i, i - 1))
+    lines.append("define i32 @f(i32 %a0) {")
+    lines.extend(body)
+    lines.append("  ret i32 %a{}".format(length))
+    lines.append("}")
+    return _write_module(directory, name, lines)
+
+
+def test_resume_after_inlining(tmpdir):
+    """
+    Test that resuming comparisons after inlining gives the same results as
+    comparing the functions from the start after each inlining round. Each
+    call in the compared function needs its own inlining round.
+    """
+    length = 10
+    first = _write_inlining_chain(tmpdir, "first", length, False, length + 1)
+    for name, last_factor in [("equal", length + 1), ("diff", length + 2)]:
+        second = _write_inlining_chain(tmpdir, name, length, True,
+                                       last_factor)
+        reports = []
+        for resume_option in [[], ["--no-resume"]]:
+            report = yaml.safe_load(check_output(
+                [SIMPLL, first, second, "--fun", "f", "--report-only",
+                 "--stats"] + resume_option))
+            stats = report.pop("stats")
+            assert stats["inlining-attempts"] >= length
+            reports.append(report)
+        assert reports[0] == reports[1]
+        assert ("diff-functions" in reports[0]) == (name == "diff")
+
+
+def test_stats_phase_times(tmpdir):
+    """
+    Test that the time of inlining is not counted in the time of the enclosing
+    comparison. The phases do not overlap, hence their total wall time cannot
+    exceed the wall time of the whole SimpLL run.
+    """
+    length = 200
+    first = _write_inlining_chain(tmpdir, "first", length, False, length + 1)
+    second = _write_inlining_chain(tmpdir, "second", length, True, length + 1)
+    start = time.time()
+    report = yaml.safe_load(check_output(
+        [SIMPLL, first, second, "--fun", "f", "--report-only", "--stats"]))
+    elapsed = time.time() - start
+    phases = {phase["phase"]: float(phase["wall-time"])
+              for phase in report["stats"]["phases"]}
+    assert phases["inlining"] > 0
+    assert sum(phases.values()) <= elapsed
+
+
+@pytest.mark.parametrize("inlining_budget, reason", [
+    (None, None),
+    ((3, 0, 0), "reached the limit of 3 inlining rounds"),
+    ((0, 10, 0), "inlining would add more than 10 instructions"),
+    ((0, 0, 2), "function g1 has 3 instructions, which exceeds the limit "
+                "of 2 for inlining")
+])
+@pytest.mark.parametrize("use_server", [False, True])
+def test_inlining_budget(tmpdir, inlining_budget, reason, use_server):
+    """
+    Test that a comparison that needs more inlining than the budget allows
+    ends as unknown and that the reason is reported. Inlining is not limited
+    by default.
+    """
+    length = 10
+    first = _write_inlining_chain(tmpdir, "first", length, False, length + 1)
+    second = _write_inlining_chain(tmpdir, "second", length, True, length + 1)
+    try:
+        _, _, objects_to_compare, _, _, unknown_funs = simplify_modules_diff(
+            first, second, "f", "f", None, "simpl", use_server=use_server,
+            inlining_budget=inlining_budget)
+    finally:
+        stop_server()
+    if reason is None:
+        assert not objects_to_compare
+        assert not unknown_funs
+    else:
+        assert unknown_funs == [{"first": "f", "second": "f",
+                                 "reason": reason}]
+
+
+@pytest.mark.parametrize("callee_first", [True, False])
+def test_control_flow_side_effects(tmpdir, callee_first):
+    """
+    Test that when only the control flow is kept, a call to a function whose
+    result is only stored is kept if the function has a side effect (a store
+    to a global variable), even though the store itself is sliced away.
+    The result must not depend on whether the called function comes before
+    or after its caller in the module.
+    """
+    callee = ["define i32 @callee(i32 %x) {",
+              "  store i32 %x, i32* @g",
+              "  ret i32 %x",
+              "}"]
+    caller = ["define void @f(i32 %x) {",
+              "  %r = call i32 @callee(i32 %x)",
+              "  store i32 %r, i32* @out",
+              "  ret void",
+              "}"]
+    globs = ["@g = global i32 0", "@out = global i32 0"]
+    first = _write_module(tmpdir, "first",
+                          globs + (callee + caller if callee_first
+                                   else caller + callee))
+    second = _write_module(tmpdir, "second",
+                           globs + callee + ["define void @f(i32 %x) {",
+                                             "  ret void",
+                                             "}"])
+    _, _, objects_to_compare, _, _, _ = simplify_modules_diff(
+        first, second, "f", "f", None, "simpl", control_flow_only=True)
+    assert [o[0].name for o in objects_to_compare] == ["f"]
+
+
+@pytest.mark.parametrize("option, value", [
+    ("use_simpll_server", True),
+    # The cache directory is created for each test
+    ("simpll_cache_dir", None),
+    ("simpll_parallel", True),
+    ("simpll_drop_unreachable", True),
+    ("simpll_drop_debug_info", True)
+])
+def test_function_diff_options(task_spec, tmpdir, option, value):
+    """
+    Test that SimpLL options that are meant to make the comparison faster do
+    not change the results. With the persistent cache, the functions are
+    compared twice, the first run fills the cache and the second one uses it.
+    """
+    config = copy.copy(task_spec.config)
+    runs = 1
+    if option == "simpll_cache_dir":
+        value = str(tmpdir)
+        runs = 2
+    setattr(config, option, value)
+    try:
+        for _ in range(runs):
+            for fun_spec in task_spec.functions.values():
+                if fun_spec.result != Result.Kind.TIMEOUT:
+                    result = functions_diff(
+                        mod_first=fun_spec.old_module,
+                        mod_second=fun_spec.new_module,
+                        fun_first=fun_spec.name, fun_second=fun_spec.name,
+                        glob_var=None, config=config)
+                    assert result.kind == fun_spec.result
+    finally:
+        stop_server()
+
+
+def test_function_diff_drop_debug_info_callstacks(task_spec):
+    """
+    Test that dropping debug metadata of functions unreachable from
+    the compared functions in SimpLL does not change the call stacks of
+    the differing functions.
+    """
+    config = copy.copy(task_spec.config)
+    config.simpll_drop_debug_info = True
+    for fun_spec in task_spec.functions.values():
+        if fun_spec.result != Result.Kind.TIMEOUT:
+            results = [
+                functions_diff(
+                    mod_first=fun_spec.old_module,
+                    mod_second=fun_spec.new_module,
+                    fun_first=fun_spec.name, fun_second=fun_spec.name,
+                    glob_var=None, config=c)
+                for c in [task_spec.config, config]]
+            assert ([(r.first.name, r.first.callstack, r.second.callstack)
+                     for r in results[0].inner.values()] ==
+                    [(r.first.name, r.first.callstack, r.second.callstack)
+                     for r in results[1].inner.values()])
+
+
+@pytest.mark.parametrize("decls, old, new", [
+    (["declare i32 @puts(i8*)"],
+     '@.str = private unnamed_addr constant [4 x i8] c"abc\\00"',
+     '@.str = private unnamed_addr constant [4 x i8] c"abd\\00"'),
+    ([], "%struct.s = type { i32, i32 }", "%struct.s = type { i64, i32 }")
+])
+def test_cache_key(tmpdir, decls, old, new):
+    """
+    Test that a cached result is not reused for functions whose instructions
+    are the same but which use a string constant with a different content or
+    a structure type with a different field type.
+    """
+    if decls:
+        body = ["define i32 @f() {",
+                "  %r = call i32 @puts(i8* getelementptr ([4 x i8], "
+                "[4 x i8]* @.str, i64 0, i64 0))",
+                "  ret i32 %r",
+                "}"]
+    else:
+        body = ["define void @f(%struct.s* %p, %struct.s* %q) {",
+                "  %v = load %struct.s, %struct.s* %p",
+                "  store %struct.s %v, %struct.s* %q",
+                "  ret void",
+                "}"]
+    first = _write_module(tmpdir, "first", [old] + decls + body)
+    second = _write_module(tmpdir, "second", [new] + decls + body)
+    cache_dir = str(tmpdir.mkdir("cache"))
+    # The first comparison stores an equal result into the cache
+    for mod, equal in [(first, True), (second, False)]:
+        _, _, objects_to_compare, _, _, _ = simplify_modules_diff(
+            first, mod, "f", "f", None, "simpl", cache_dir=cache_dir)
+        assert (not objects_to_compare) == equal
+
+
+def test_function_diff_parallel(task_spec):
+    """
+    Test that comparing functions in worker processes (used by the --jobs
+    option) gives the same results as the sequential comparison.
+    """
+    functions = [(fun_spec.name, fun_spec.old_module, fun_spec.new_module)
+                 for fun_spec in task_spec.functions.values()
+                 if fun_spec.result != Result.Kind.TIMEOUT]
+    with Pool(2, initializer=_init_worker,
+              initargs=(task_spec.config, False)) as pool:
+        for group_results, _ in pool.imap_unordered(
+                _compare_group, _group_by_modules(functions)):
+            for fun, result in group_results:
+                assert result.kind == task_spec.functions[fun].result
+
+
+def test_function_list(task_spec):
+    """
+    Test comparison of functions in the batch mode of SimpLL. All functions
+    of a pair of modules are compared in a single run and the result for each
+    of them must be the same as when it is compared alone. Functions found
+    equal must be syntactically equal.
+    """
+    modules = {}
+    for fun_spec in task_spec.functions.values():
+        if fun_spec.result != Result.Kind.TIMEOUT:
+            modules.setdefault((fun_spec.old_module.llvm,
+                                fun_spec.new_module.llvm), []).append(
+                fun_spec.name)
+    for (first, second), funs in modules.items():
+        equal = compare_function_list(first, second, funs,
+                                      task_spec.control_flow_only)
+        for fun in funs:
+            single = compare_function_list(first, second, [fun],
+                                           task_spec.control_flow_only)
+            assert (fun in equal) == (fun in single)
+            if fun in equal:
+                assert (task_spec.functions[fun].result ==
+                        Result.Kind.EQUAL_SYNTAX)
+
+
+def test_function_list_roots(tmpdir):
+    """
+    Test that the results of functions compared in a single batch run are
+    attributed to each of the compared functions according to the functions
+    it calls. Only the leaf of the call chain differs, hence all functions
+    calling it differ and the recursive functions are equal.
+    """
+    length = 5
+    first = _write_call_chain(tmpdir, "first", length, 1)
+    second = _write_call_chain(tmpdir, "second", length, 2)
+    funs = ["f{}".format(i) for i in range(length + 1)] + ["even", "odd"]
+    equal = compare_function_list(first, second, funs)
+    assert equal == {"even", "odd"}
+    for fun in funs:
+        assert (fun in equal) == (fun in compare_function_list(first, second,
+                                                               [fun]))
@@ -6,6 +6,8 @@ the "modules" key in the YAML spec file.
 """
 from diffkemp.semdiff.function_diff import functions_diff
 from diffkemp.semdiff.result import Result
+from diffkemp.simpll.simpll import compare_variable_list, \
+    simplify_modules_diff
 from tests.regression.task_spec import ModuleParamSpec, specs_path, tasks_path
 import glob
 import os
@@ -98,3 +100,27 @@ class TestClassModule(object):
                     fun_first=fun_spec.name, fun_second=fun_spec.name,
                     glob_var=task_spec.get_param(), config=task_spec.config)
                 assert result.kind == fun_spec.result
+
+    def test_variable_list(self, task_spec):
+        """
+        Test that comparing a function w.r.t. multiple parameters of the module
+        in a single SimpLL run (--var-list) gives the same verdicts as
+        comparing it w.r.t. each parameter separately (--var).
+        """
+        params = [s.param for _, s in specs
+                  if (s.old_kernel_dir == task_spec.old_kernel_dir and
+                      s.new_kernel_dir == task_spec.new_kernel_dir and
+                      s.dir == task_spec.dir and s.mod == task_spec.mod)]
+        variables = [task_spec.old_module.find_param_var(param).name
+                     for param in params]
+        for fun in task_spec.functions:
+            equal = compare_variable_list(
+                task_spec.old_module.llvm, task_spec.new_module.llvm, fun,
+                variables, task_spec.control_flow_only)
+            for var in variables:
+                _, _, objects_to_compare, _, _, unknown_funs = \
+                    simplify_modules_diff(
+                        task_spec.old_module.llvm, task_spec.new_module.llvm,
+                        fun, fun, var, var, task_spec.control_flow_only)
+                assert ((var in equal) ==
+                        (not objects_to_compare and not unknown_funs))
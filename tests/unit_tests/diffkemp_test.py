@@ -0,0 +1,34 @@
+"""
+Unit tests for the comparison of snapshots.
+Testing functions located in diffkemp.py.
+"""
+
+from diffkemp.diffkemp import _group_by_modules
+from diffkemp.llvm_ir.kernel_module import LlvmKernelModule
+
+
+def test_group_by_modules():
+    """
+    Test that functions sharing a module in any of the snapshots are put into
+    the same group and that the largest groups come first.
+    """
+    old = [LlvmKernelModule("old/{}.ll".format(i)) for i in range(4)]
+    new = [LlvmKernelModule("new/{}.ll".format(i)) for i in range(4)]
+    functions = [("a", old[0], new[0]),
+                 ("b", old[1], new[1]),
+                 ("c", old[0], new[2]),
+                 ("d", old[3], new[2]),
+                 ("e", old[2], new[3])]
+    groups = _group_by_modules(functions)
+    assert [[f[0] for f in group] for group in groups] == \
+        [["a", "c", "d"], ["b"], ["e"]]
+
+
+def test_group_by_modules_single():
+    """Test that functions sharing no modules form separate groups."""
+    functions = [(str(i), LlvmKernelModule("old/{}.ll".format(i)),
+                  LlvmKernelModule("new/{}.ll".format(i)))
+                 for i in range(3)]
+    groups = _group_by_modules(functions)
+    assert sorted([f[0] for f in group] for group in groups) == \
+        [["0"], ["1"], ["2"]]
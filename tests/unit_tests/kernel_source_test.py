@@ -95,6 +95,25 @@ def test_get_module_for_symbol_fail(source):
         source.get_module_for_symbol("__get_user_2")
 
 
+def test_get_module_for_symbol_index(source):
+    """Test getting LLVM module defining a symbol from the symbol index."""
+    source.symbol_index = {"snd_request_card": "sound/core/sound.ll"}
+    mod = source.get_module_for_symbol("snd_request_card")
+    assert mod.llvm == os.path.join(source.kernel_dir, "sound/core/sound.ll")
+
+
+def test_get_module_for_symbol_index_miss(source):
+    """
+    Test that a symbol missing in the symbol index is looked up using CScope.
+    """
+    source.symbol_index = {"snd_request_card": "sound/core/sound.ll"}
+    mod = source.get_module_for_symbol("__alloc_workqueue_key")
+    assert mod.llvm == os.path.join(source.kernel_dir, "kernel/workqueue.ll")
+    assert mod.has_function("__alloc_workqueue_key")
+    with pytest.raises(SourceNotFoundException):
+        source.get_module_for_symbol("__get_user_2")
+
+
 @pytest.mark.parametrize("name, llvm_file, table", [
     ("net.core.message_burst",
      "net/core/sysctl_net_core.ll",
@@ -0,0 +1,216 @@
+"""
+Unit tests for running SimpLL.
+Testing functions located in simpll/simpll.py. A module compared with itself
+must always be found syntactically equal.
+"""
+
+from diffkemp.llvm_ir.kernel_source import KernelSource
+from diffkemp.simpll.simpll import add_suffix, compare_function_list, \
+    get_server, simplify_modules_diff, stop_server, SimpLLException, \
+    SimpLLStats
+import diffkemp.simpll.simpll as simpll
+import os
+import pytest
+import shutil
+import tempfile
+
+
+@pytest.fixture
+def source():
+    """Create KernelSource shared among multiple tests."""
+    s = KernelSource("kernel/linux-3.10.0-957.el7", True)
+    yield s
+    s.finalize()
+
+
+@pytest.fixture
+def mod(source):
+    """Create kernel module shared among multiple tests."""
+    return source.get_module_from_source("sound/core/sound.c")
+
+
+@pytest.fixture
+def server():
+    """Stop the SimpLL server after the test."""
+    yield
+    stop_server()
+
+
+@pytest.mark.parametrize("use_server", [False, True])
+def test_verdict_only_equal(mod, server, use_server):
+    """
+    Test that the simplified modules are not written if the compared functions
+    are syntactically equal.
+    """
+    first, second, objects_to_compare, _, _, _ = simplify_modules_diff(
+        mod.llvm, mod.llvm, "snd_request_card", "snd_request_card", None,
+        "verdict", use_server=use_server)
+    assert not objects_to_compare
+    assert first is None and second is None
+    assert not os.path.isfile(add_suffix(mod.llvm, "verdict"))
+
+
+@pytest.mark.parametrize("use_server", [False, True])
+def test_verdict_only_not_equal(mod, server, use_server):
+    """
+    Test that the simplified modules are written if the compared functions
+    differ.
+    """
+    out_file = add_suffix(mod.llvm, "verdict")
+    try:
+        first, second, objects_to_compare, _, _, _ = simplify_modules_diff(
+            mod.llvm, mod.llvm, "snd_request_card", "snd_lookup_minor_data",
+            None, "verdict", use_server=use_server)
+        assert objects_to_compare
+        assert first.llvm == out_file and second.llvm == out_file
+        assert os.path.isfile(out_file)
+    finally:
+        if os.path.isfile(out_file):
+            os.remove(out_file)
+
+
+@pytest.fixture
+def stats(monkeypatch):
+    """Collect statistics of SimpLL runs during the test."""
+    monkeypatch.setattr(simpll, "_stats", SimpLLStats())
+    return simpll._stats
+
+
+def test_cache(mod, stats):
+    """
+    Test that results stored in the cache are reused by a subsequent run and
+    that they do not change the result.
+    """
+    cache_dir = tempfile.mkdtemp()
+    try:
+        instructions = []
+        for _ in range(2):
+            compared = stats.counters.get("instructions-compared", 0)
+            _, _, objects_to_compare, _, _, unknown_funs = \
+                simplify_modules_diff(mod.llvm, mod.llvm, "snd_request_card",
+                                      "snd_request_card", None, "cache",
+                                      cache_dir=cache_dir)
+            assert not objects_to_compare
+            assert not unknown_funs
+            assert os.listdir(cache_dir)
+            instructions.append(
+                stats.counters["instructions-compared"] - compared)
+        assert instructions[1] < instructions[0]
+    finally:
+        shutil.rmtree(cache_dir)
+
+
+@pytest.mark.parametrize("use_server", [False, True])
+def test_stats(mod, server, stats, use_server):
+    """Test that statistics of a single SimpLL run are collected."""
+    simplify_modules_diff(mod.llvm, mod.llvm, "snd_request_card",
+                          "snd_request_card", None, "stats",
+                          use_server=use_server)
+    assert stats.runs == 1
+    assert "comparison" in stats.phases
+    assert all(wall >= 0 and cpu >= 0 for wall, cpu in stats.phases.values())
+    assert stats.counters["functions-compared"] > 0
+    assert stats.counters["instructions-compared"] > 0
+    assert stats.peak_rss > 0
+
+
+def test_stats_batch(mod, stats):
+    """
+    Test that statistics of a batch SimpLL run (one YAML document per compared
+    function) are collected exactly once.
+    """
+    equal = compare_function_list(mod.llvm, mod.llvm,
+                                  ["snd_request_card",
+                                   "snd_lookup_minor_data"])
+    assert equal == {"snd_request_card", "snd_lookup_minor_data"}
+    assert stats.runs == 1
+    assert stats.counters["functions-compared"] >= 2
+
+
+def test_server_equal(mod, server):
+    """Test comparing a function with itself by the SimpLL server."""
+    for _ in range(2):
+        # The second request uses the module cached by the server
+        _, _, objects_to_compare, _, _, unknown_funs = simplify_modules_diff(
+            mod.llvm, mod.llvm, "snd_request_card", "snd_request_card", None,
+            "server", use_server=True)
+        assert not objects_to_compare
+        assert not unknown_funs
+
+
+@pytest.mark.parametrize("use_server", [False, True])
+def test_unknown_function(mod, server, use_server):
+    """
+    Test that a missing function is reported as an error both by the SimpLL
+    server and by a SimpLL process, and that the server keeps running.
+    """
+    with pytest.raises(SimpLLException):
+        simplify_modules_diff(mod.llvm, mod.llvm, "no_such_function",
+                              "no_such_function", None, "server",
+                              use_server=use_server)
+    if use_server:
+        assert get_server().running()
+
+
+def test_server_options(server):
+    """
+    Test that the SimpLL server is restarted when it is requested with
+    different options than those it was started with.
+    """
+    cache_dir = tempfile.mkdtemp()
+    try:
+        first = get_server()
+        assert get_server() is first
+        second = get_server(cache_dir=cache_dir)
+        assert second is not first
+        assert not first.running()
+        assert second.cache_dir == cache_dir
+        assert get_server(verbose=True, cache_dir=cache_dir) is not second
+    finally:
+        shutil.rmtree(cache_dir)
+
+
+def test_server_restart(mod, server):
+    """Test that the SimpLL server is restarted after it was stopped."""
+    get_server()
+    stop_server()
+    _, _, objects_to_compare, _, _, _ = simplify_modules_diff(
+        mod.llvm, mod.llvm, "snd_request_card", "snd_request_card", None,
+        "server", use_server=True)
+    assert not objects_to_compare
+
+
+@pytest.mark.parametrize("use_server", [False, True])
+def test_parallel(mod, server, use_server):
+    """Test comparing a function with itself with parallel preprocessing."""
+    _, _, objects_to_compare, _, _, unknown_funs = simplify_modules_diff(
+        mod.llvm, mod.llvm, "snd_request_card", "snd_request_card", None,
+        "parallel", use_server=use_server, parallel=True)
+    assert not objects_to_compare
+    assert not unknown_funs
+
+
+@pytest.mark.parametrize("use_server", [False, True])
+def test_drop_unreachable(mod, server, use_server):
+    """
+    Test comparing a function with itself when bodies of unreachable functions
+    are deleted.
+    """
+    _, _, objects_to_compare, _, _, unknown_funs = simplify_modules_diff(
+        mod.llvm, mod.llvm, "snd_request_card", "snd_request_card", None,
+        "drop", use_server=use_server, drop_unreachable=True)
+    assert not objects_to_compare
+    assert not unknown_funs
+
+
+@pytest.mark.parametrize("use_server", [False, True])
+def test_drop_debug_info(mod, server, use_server):
+    """
+    Test comparing a function with itself when debug metadata of unreachable
+    functions are dropped.
+    """
+    _, _, objects_to_compare, _, _, unknown_funs = simplify_modules_diff(
+        mod.llvm, mod.llvm, "snd_request_card", "snd_request_card", None,
+        "drop", use_server=use_server, drop_debug_info=True)
+    assert not objects_to_compare
+    assert not unknown_funs